@@ -9,7 +9,12 @@ LOCAL_CFLAGS    := -Werror -DJNI_WRAPPER \
                 -I../../tiff-3.8.2-1/include
 LOCAL_SRC_FILES := gl_code.cpp ../../src/RenderState.cpp ../../src/RenderStateGL1.cpp \
                 ../../src/Mesh.cpp  ../../src/MeshGL1.cpp ../../src/Material.cpp \
-                ../../src/Vertex.cpp ../../src/Scene.cpp ../../src/Dragon.cpp
+                ../../src/Vertex.cpp ../../src/Scene.cpp ../../src/Dragon.cpp \
+                ../../src/Thread.cpp ../../src/DrawRecorder.cpp \
+                ../../src/SceneGraph.cpp ../../src/Frustum.cpp \
+                ../../src/OcclusionCuller.cpp ../../src/BoundingVolumeHierarchy.cpp \
+                ../../src/TriangleTree.cpp ../../src/DragonPoses.cpp \
+                ../../src/AnimationCurve.cpp ../../src/JobSystem.cpp
 LOCAL_LDLIBS    := -llog -lGLESv1_CM \
                 -L/opt/android-ndk/sources/cxx-stl/stlport/libs/armeabi -lstlport_static \
                 -L../../tiff-3.8.2-1/armeabi -ltiff -ltiffdecoder
@@ -0,0 +1,73 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_ANIMATION_CURVE_H
+#define INITIALS_ANIMATION_CURVE_H
+
+#include <vector>
+
+// Periodic function of time sampled once into a table, so that evaluating it
+// is an interpolated read instead of a call to cos or sqrt.
+class AnimationCurve
+{
+public:
+    typedef double (*Function)(double t);
+
+    // what a curve is baked from, which tests bake again to check it
+    typedef struct
+    {
+        const char *name;
+        Function function;
+        double period;
+        int samples;
+        float tolerance;
+    } Source;
+
+    AnimationCurve();
+
+    // sample one period of f, doubling the samples until interpolating them
+    // is closer to f than tolerance or there are maxSamples of them. Points
+    // where f is not smooth should fall on samples, i.e. on multiples of
+    // period / samples.
+    void bake(Function f, double period, int samples, float tolerance, int maxSamples = 65536);
+    void bake(const Source &source);
+
+    float value(double t) const;
+
+    int size() const;
+    // largest difference with f found while baking
+    float error() const;
+    // largest difference with f at n points spread over one period
+    float measure(Function f, int n) const;
+
+private:
+    float sampleError(Function f) const;
+
+    std::vector<float> m_samples;   // one more than the size, the first repeated
+    double m_period;
+    double m_frequency;
+    float m_tolerance;
+    float m_error;
+};
+
+#endif
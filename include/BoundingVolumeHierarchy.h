@@ -0,0 +1,98 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_BOUNDING_VOLUME_HIERARCHY_H
+#define INITIALS_BOUNDING_VOLUME_HIERARCHY_H
+
+#include <vector>
+#include "Vertex.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+
+// Tree of bounding spheres over the instances of a scene. It is built once
+// from where the instances are and then refit as they move, which only merges
+// the spheres again from the leaves up. When refitting made it too loose
+// (instances moved far from their neighbours) it is built again.
+class BoundingVolumeHierarchy
+{
+public:
+    BoundingVolumeHierarchy();
+
+    typedef struct
+    {
+        vec3 center;
+        float radius;               // negative when the instance is empty
+        int weight;                 // added to the culled counts
+    } Bounds;
+
+    // move the instances, building the tree again when their number changed
+    void update(const std::vector<Bounds> &instances);
+
+    typedef struct
+    {
+        int index;
+        bool inside;                // the whole instance is inside the frustum
+    } Visible;
+
+    // instances which are neither outside the frustum nor occluded, in the
+    // order they were given. Weights of the culled ones are added to the counts.
+    void cull(const Frustum &frustum, const OcclusionCuller *occlusion,
+              std::vector<Visible> &visible, int &outside, int &occluded) const;
+
+    typedef struct
+    {
+        int index;
+        float distance;             // along the ray, zero when it starts inside
+    } RayHit;
+
+    // instances whose sphere is hit by the ray, nearest first
+    void intersect(const vec3 &origin, const vec3 &direction, std::vector<RayHit> &hits) const;
+
+    int nodeCount() const;
+    int rebuildCount() const;
+
+private:
+    typedef struct
+    {
+        vec3 center;
+        float radius;
+        int weight;
+        int right;                  // the left child follows its parent
+        int instance;               // leaves only, otherwise -1
+    } Node;
+
+    void build(const std::vector<Bounds> &instances);
+    int buildNode(std::vector<int> &order, int first, int last, const std::vector<Bounds> &instances);
+    // false when instances became empty or stopped being empty
+    bool refit(const std::vector<Bounds> &instances);
+    float looseness() const;
+    static float component(const vec3 &v, int axis);
+
+    std::vector<Node> m_nodes;      // parents come before their children
+    std::vector<int> m_unbounded;   // empty instances, always visible
+    int m_count;
+    float m_builtLooseness;
+    int m_rebuilds;
+};
+
+#endif
@@ -27,6 +27,7 @@
 #include <inttypes.h>
 #include "Material.h"
 #include "RenderState.h"
+#include "DragonPoses.h"
 
 class Scene;
 
@@ -40,7 +41,9 @@ public:
         Jumping
     };
 
-    Dragon(Kind kind, RenderState *state);
+    // the pose of the dragon is kept in poses, or in its own if there are none
+    Dragon(Kind kind, RenderState *state, DragonPoses *poses = 0);
+    ~Dragon();
 
     void setDetailLevel(int level);
 
@@ -48,10 +51,16 @@ public:
     Material & scalesMaterial();
     Material & wingMaterial();
     Material & membraneMaterial();
-
-    float frontLegsAngle() const;
-    float alpha() const;
-    float beta() const;
+    void registerMaterials();
+    // look up the meshes the dragon is made of, once they are loaded
+    void acquireMeshes();
+    void releaseMeshes();
+
+    // references, so that scene nodes can follow them
+    const float & frontLegsAngle() const;
+    const float & alpha() const;
+    const float & beta() const;
+    const float & wingBeat() const;
     void setAlpha(float v);
     void setBeta(float v);
 
@@ -76,10 +85,22 @@ public:
     void drawTail();
     void drawTailEnd();
 
-    void animate(float t);
-
 private:
-    Kind m_kind;
+    const float & pose(int parameter) const;
+
+    enum MeshPart
+    {
+        HeadMesh,
+        LetterAMesh,
+        LetterSMesh,
+        JointMesh,
+        ChestMesh,
+        MembraneMesh,
+        TailEndMesh,
+        MeshCount
+    };
+
+    MeshHandle m_meshes[MeshCount];
     uint32_t m_jointParts;
     uint32_t m_chestParts;
     uint32_t m_tailEndParts;
@@ -87,18 +108,9 @@ private:
     Material m_scalesMaterial;
     Material m_wingMaterial;
     Material m_membraneMaterial;
-    float theta_jaw;
-    float theta_head_z;
-    float theta_head_y;
-    float theta_neck;
-    float theta_wing;
-    float theta_wing_joint;
-    float theta_front_legs;
-    float theta_back_legs;
-    float theta_paw;
-    float theta_tail;
-    float m_alpha;              //
-    float m_beta;               // animation-dependent variables
+    DragonPoses *m_poses;
+    int m_pose;                 // index of the dragon in the poses
+    bool m_ownsPoses;
 };
 
 #endif
@@ -0,0 +1,108 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_DRAGON_POSES_H
+#define INITIALS_DRAGON_POSES_H
+
+#include <vector>
+#include "AnimationCurve.h"
+
+// Animated parameters of many dragons, stored as one array per parameter so
+// that they are animated together, four dragons at a time when SSE is there.
+// The curves they follow are baked into tables the first time poses are made.
+// The arrays never grow, so references to parameters can be kept.
+class DragonPoses
+{
+public:
+    DragonPoses(int capacity);
+
+    enum Parameter
+    {
+        Jaw,
+        HeadZ,
+        HeadY,
+        Neck,
+        Wing,
+        WingJoint,
+        FrontLegs,
+        BackLegs,
+        Paw,
+        Tail,
+        TailJoint,                  // angles of the ten joints of the tail
+        WingBeat = TailJoint + 10,  // from -1 to 1, as the wings go up and down
+        Alpha,
+        Beta,                       // set by the scene
+        ParameterCount
+    };
+
+    int count() const;
+    int capacity() const;
+
+    // kind is a Dragon::Kind, returns the index of the dragon or -1 when full
+    int add(int kind);
+    // time added to the animation time of one dragon
+    void setTimeOffset(int index, float offset);
+
+    float & value(int parameter, int index);
+    const float & value(int parameter, int index) const;
+
+    // compute the pose of every dragon at a given time
+    void animate(float t);
+    // poses part of the way from one to the other, which have the same dragons
+    void interpolate(const DragonPoses &from, const DragonPoses &to, float f);
+    // value part of the way from a to b, going the short way around when
+    // they are angles more than half a turn apart
+    static float mix(float a, float b, float f);
+    // the curves the poses are made of, before they are baked
+    static const AnimationCurve::Source * curveSources(int &count);
+
+private:
+    // curves read from the tables, from which the parameters are made
+    enum Channel
+    {
+        BeatChannel,
+        LegsChannel,
+        WingJointChannel,
+        SlowChannel,
+        FastChannel,
+        TailChannel,
+        ChannelCount
+    };
+
+    static void bakeCurves();
+    static void animateBlockTask(void *arg, int index);
+    void animateBlock(int block);
+    void sampleChannels(int index, double t);
+    void combineScalar(int index);
+    void combineBatch(int first);
+
+    int m_count;
+    float m_time;                   // being animated to
+    int m_stride;                   // capacity rounded up to four
+    std::vector<float> m_values;    // one row of m_stride values per parameter
+    std::vector<float> m_channels;  // one row per channel, the same way
+    std::vector<float> m_kinds;
+    std::vector<float> m_timeOffsets;
+};
+
+#endif
@@ -0,0 +1,88 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_DRAW_LIST_H
+#define INITIALS_DRAW_LIST_H
+
+#include <map>
+#include <vector>
+#include <inttypes.h>
+#include "Material.h"
+#include "Vertex.h"
+
+class Mesh;
+
+class DrawCommand
+{
+public:
+    Mesh *mesh;
+    uint32_t program;       // backend-specific shader program index
+    uint32_t material;      // index in the list's material table
+    float depth;            // distance from the eye, along the view axis
+    matrix4 modelView;
+};
+
+// Per-frame list of draw commands which can be sorted before being submitted,
+// to reduce the number of state changes.
+class DrawList
+{
+public:
+    DrawList();
+
+    enum SortMode
+    {
+        SortByState,        // program, then material, then mesh
+        SortFrontToBack     // closest objects first, to reduce overdraw
+    };
+
+    void clear();
+    uint32_t addMaterial(const Material &m);
+    void add(Mesh *mesh, const matrix4 &modelView, uint32_t material, uint32_t program = 0);
+    void sort(SortMode mode);
+
+    uint32_t size() const;
+    // i-th command, in sorted order once sort() has been called
+    const DrawCommand & at(uint32_t i) const;
+    const Material & material(uint32_t index) const;
+    uint32_t materialCount() const;
+
+private:
+    typedef struct
+    {
+        uint64_t key;
+        uint32_t index;
+    } SortItem;
+
+    uint64_t sortKey(const DrawCommand &c, SortMode mode) const;
+    static void radixSort(std::vector<SortItem> &items, std::vector<SortItem> &temp);
+
+    std::vector<DrawCommand> m_commands;
+    std::vector<SortItem> m_order;
+    std::vector<SortItem> m_temp;
+    std::vector<Material> m_materials;
+    std::map<uint32_t, uint32_t> m_materialIndices;
+    uint32_t m_lastMaterialID;
+    uint32_t m_lastMaterial;
+};
+
+#endif
@@ -0,0 +1,99 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_DRAW_RECORDER_H
+#define INITIALS_DRAW_RECORDER_H
+
+#include <vector>
+#include "RenderState.h"
+
+// Records what is drawn with it instead of drawing it, so that a part of the
+// scene can be traversed on another thread and drawn later on the GL thread.
+// It only has a model-view matrix stack and does not touch the target, except
+// to look up meshes by name.
+class DrawRecorder : public RenderState
+{
+public:
+    DrawRecorder(const RenderState *target);
+
+    // discard the recorded draws, start from the target's model-view matrix
+    void begin(const matrix4 &modelView);
+    // draw the recorded meshes, in the same order
+    void replay(RenderState *target) const;
+    // same for meshes recorded from the identity, which are placed in the view
+    void replay(RenderState *target, const matrix4 &view) const;
+    size_t size() const;
+
+    virtual Mesh * createMesh() const;
+    virtual void drawMesh(Mesh *m);
+    virtual void drawMesh(MeshHandle h);
+    virtual void drawMesh(const string &name);
+    virtual void freeTextures();
+
+    // matrix operations
+    virtual void setMatrixMode(MatrixMode newMode);
+
+    virtual void loadIdentity();
+    virtual void multiplyMatrix(const matrix4 &m);
+    virtual void pushMatrix();
+    virtual void popMatrix();
+
+    virtual void translate(float dx, float dy, float dz);
+    virtual void rotate(float angle, float rx, float ry, float rz);
+    virtual void scale(float sx, float sy, float sz);
+
+    virtual matrix4 currentMatrix() const;
+
+    // general state operations
+    virtual void beginFrame(int width, int heigth);
+    virtual void setupViewport(int width, int heigth);
+    virtual void endFrame();
+
+    // material operations
+    virtual void pushMaterial(const Material &m);
+    virtual void popMaterial();
+
+private:
+    enum
+    {
+        NoMaterial = 0xffffffff     // drawn with the target's current material
+    };
+
+    typedef struct
+    {
+        Mesh *mesh;
+        uint32_t material;          // index in m_materials
+        matrix4 modelView;
+    } RecordedDraw;
+
+    void replayDraws(RenderState *target, const matrix4 *view) const;
+
+    const RenderState *m_target;
+    matrix4 m_matrix;
+    std::vector<matrix4> m_matrixStack;
+    std::vector<uint32_t> m_materialStack;
+    std::vector<Material> m_materials;
+    std::vector<RecordedDraw> m_draws;
+};
+
+#endif
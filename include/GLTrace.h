@@ -0,0 +1,265 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_GL_TRACE_H
+#define INITIALS_GL_TRACE_H
+
+#include <string>
+#include <cstdio>
+#include <inttypes.h>
+#include "Platform.h"
+
+using namespace std;
+
+// Entry points used by the renderers while drawing. Functions marked with R
+// go through a shadow copy of the GL state, which is used to find redundant
+// calls (i.e. calls which do not change the state).
+#define GL_TRACE_ENTRIES(X, R) \
+    R(void, glActiveTexture, (GLenum texture), (texture)) \
+    R(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+    R(void, glBindBufferBase, (GLenum target, GLuint index, GLuint buffer), (target, index, buffer)) \
+    R(void, glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), (target, index, buffer, offset, size)) \
+    R(void, glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+    R(void, glBindTexture, (GLenum target, GLuint texture), (target, texture)) \
+    R(void, glBindVertexArray, (GLuint array), (array)) \
+    X(void, glBlitFramebuffer, (GLint sx0, GLint sy0, GLint sx1, GLint sy1, GLint dx0, GLint dy0, GLint dx1, GLint dy1, GLbitfield mask, GLenum filter), (sx0, sy0, sx1, sy1, dx0, dy0, dx1, dy1, mask, filter)) \
+    X(void, glBufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage)) \
+    X(void, glBufferStorage, (GLenum target, GLsizeiptr size, const void *data, GLbitfield flags), (target, size, data, flags)) \
+    X(void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data)) \
+    X(void, glClear, (GLbitfield mask), (mask)) \
+    X(void, glClearColor, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), (r, g, b, a)) \
+    X(GLenum, glClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout)) \
+    R(void, glDeleteBuffers, (GLsizei n, const GLuint *buffers), (n, buffers)) \
+    X(void, glDeleteSync, (GLsync sync), (sync)) \
+    R(void, glDeleteTextures, (GLsizei n, const GLuint *textures), (n, textures)) \
+    R(void, glDeleteVertexArrays, (GLsizei n, const GLuint *arrays), (n, arrays)) \
+    R(void, glDisable, (GLenum cap), (cap)) \
+    R(void, glDisableVertexAttribArray, (GLuint index), (index)) \
+    X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count)) \
+    X(void, glDrawArraysInstancedARB, (GLenum mode, GLint first, GLsizei count, GLsizei instances), (mode, first, count, instances)) \
+    R(void, glEnable, (GLenum cap), (cap)) \
+    R(void, glEnableVertexAttribArray, (GLuint index), (index)) \
+    X(GLsync, glFenceSync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+    X(void, glFlush, (void), ()) \
+    X(void *, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access)) \
+    X(void, glMultiDrawArraysIndirect, (GLenum mode, const void *indirect, GLsizei count, GLsizei stride), (mode, indirect, count, stride)) \
+    R(void, glPopAttrib, (void), ()) \
+    X(void, glPushAttrib, (GLbitfield mask), (mask)) \
+    R(void, glUniform1f, (GLint location, GLfloat v), (location, v)) \
+    R(void, glUniform1i, (GLint location, GLint v), (location, v)) \
+    R(void, glUniform4fv, (GLint location, GLsizei count, const GLfloat *v), (location, count, v)) \
+    R(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *v), (location, count, transpose, v)) \
+    R(void, glUseProgram, (GLuint program), (program)) \
+    R(void, glVertexAttribDivisorARB, (GLuint index, GLuint divisor), (index, divisor)) \
+    R(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), (index, size, type, normalized, stride, pointer)) \
+    X(void, glViewport, (GLint x, GLint y, GLsizei w, GLsizei h), (x, y, w, h)) \
+    X(void, glCallList, (GLuint list), (list)) \
+    X(void, glDisableClientState, (GLenum array), (array)) \
+    X(void, glEnableClientState, (GLenum array), (array)) \
+    X(void, glLightfv, (GLenum light, GLenum pname, const GLfloat *params), (light, pname, params)) \
+    X(void, glLoadIdentity, (void), ()) \
+    X(void, glMaterialf, (GLenum face, GLenum pname, GLfloat param), (face, pname, param)) \
+    X(void, glMaterialfv, (GLenum face, GLenum pname, const GLfloat *params), (face, pname, params)) \
+    R(void, glMatrixMode, (GLenum mode), (mode)) \
+    X(void, glMultMatrixf, (const GLfloat *m), (m)) \
+    X(void, glNormalPointer, (GLenum type, GLsizei stride, const void *pointer), (type, stride, pointer)) \
+    X(void, glPolygonMode, (GLenum face, GLenum mode), (face, mode)) \
+    X(void, glPopMatrix, (void), ()) \
+    X(void, glPushMatrix, (void), ()) \
+    X(void, glRotatef, (GLfloat angle, GLfloat x, GLfloat y, GLfloat z), (angle, x, y, z)) \
+    X(void, glScalef, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(void, glShadeModel, (GLenum mode), (mode)) \
+    X(void, glTexCoordPointer, (GLint size, GLenum type, GLsizei stride, const void *pointer), (size, type, stride, pointer)) \
+    X(void, glTranslatef, (GLfloat x, GLfloat y, GLfloat z), (x, y, z)) \
+    X(void, glVertexPointer, (GLint size, GLenum type, GLsizei stride, const void *pointer), (size, type, stride, pointer))
+
+// Optional layer between the renderers and the driver. When enabled, it counts
+// the calls made to every entry point during a frame, how many of them were
+// redundant and how much CPU time was spent in the driver.
+class GLTrace
+{
+public:
+    enum Entry
+    {
+#define GL_TRACE_ENTRY(ret, name, params, args) name##Entry,
+        GL_TRACE_ENTRIES(GL_TRACE_ENTRY, GL_TRACE_ENTRY)
+#undef GL_TRACE_ENTRY
+        EntryCount
+    };
+
+    static bool enabled();
+    static void setEnabled(bool enabled);
+    // when set, the report of every frame traced is written to the file
+    static void setDumpFile(FILE *f);
+
+    static void beginFrame();
+    static void endFrame();
+    // report of the last frame traced
+    static string report();
+
+    // measure one call to the driver
+    class Call
+    {
+    public:
+        Call(Entry entry, bool redundant = false);
+        ~Call();
+
+    private:
+        Entry m_entry;
+        bool m_redundant;
+        double m_start;
+    };
+
+private:
+    static bool m_enabled;
+    static bool m_inFrame;
+    static FILE *m_dumpFile;
+    static uint32_t m_calls[EntryCount];
+    static uint32_t m_redundant[EntryCount];
+    static double m_time[EntryCount];
+    static string m_report;
+};
+
+#define GL_TRACE_DECLARE(ret, name, params, args) ret traced_##name params;
+GL_TRACE_ENTRIES(GL_TRACE_DECLARE, GL_TRACE_DECLARE)
+#undef GL_TRACE_DECLARE
+
+// redirect the calls made by the file including this header to the layer
+#ifndef GL_TRACE_IMPLEMENTATION
+#undef glActiveTexture
+#define glActiveTexture traced_glActiveTexture
+#undef glBindBuffer
+#define glBindBuffer traced_glBindBuffer
+#undef glBindBufferBase
+#define glBindBufferBase traced_glBindBufferBase
+#undef glBindBufferRange
+#define glBindBufferRange traced_glBindBufferRange
+#undef glBindFramebuffer
+#define glBindFramebuffer traced_glBindFramebuffer
+#undef glBindTexture
+#define glBindTexture traced_glBindTexture
+#undef glBindVertexArray
+#define glBindVertexArray traced_glBindVertexArray
+#undef glBlitFramebuffer
+#define glBlitFramebuffer traced_glBlitFramebuffer
+#undef glBufferData
+#define glBufferData traced_glBufferData
+#undef glBufferStorage
+#define glBufferStorage traced_glBufferStorage
+#undef glBufferSubData
+#define glBufferSubData traced_glBufferSubData
+#undef glClear
+#define glClear traced_glClear
+#undef glClearColor
+#define glClearColor traced_glClearColor
+#undef glClientWaitSync
+#define glClientWaitSync traced_glClientWaitSync
+#undef glDeleteBuffers
+#define glDeleteBuffers traced_glDeleteBuffers
+#undef glDeleteSync
+#define glDeleteSync traced_glDeleteSync
+#undef glDeleteTextures
+#define glDeleteTextures traced_glDeleteTextures
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays traced_glDeleteVertexArrays
+#undef glDisable
+#define glDisable traced_glDisable
+#undef glDisableVertexAttribArray
+#define glDisableVertexAttribArray traced_glDisableVertexAttribArray
+#undef glDrawArrays
+#define glDrawArrays traced_glDrawArrays
+#undef glDrawArraysInstancedARB
+#define glDrawArraysInstancedARB traced_glDrawArraysInstancedARB
+#undef glEnable
+#define glEnable traced_glEnable
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray traced_glEnableVertexAttribArray
+#undef glFenceSync
+#define glFenceSync traced_glFenceSync
+#undef glFlush
+#define glFlush traced_glFlush
+#undef glMapBufferRange
+#define glMapBufferRange traced_glMapBufferRange
+#undef glMultiDrawArraysIndirect
+#define glMultiDrawArraysIndirect traced_glMultiDrawArraysIndirect
+#undef glPopAttrib
+#define glPopAttrib traced_glPopAttrib
+#undef glPushAttrib
+#define glPushAttrib traced_glPushAttrib
+#undef glUniform1f
+#define glUniform1f traced_glUniform1f
+#undef glUniform1i
+#define glUniform1i traced_glUniform1i
+#undef glUniform4fv
+#define glUniform4fv traced_glUniform4fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv traced_glUniformMatrix4fv
+#undef glUseProgram
+#define glUseProgram traced_glUseProgram
+#undef glVertexAttribDivisorARB
+#define glVertexAttribDivisorARB traced_glVertexAttribDivisorARB
+#undef glVertexAttribPointer
+#define glVertexAttribPointer traced_glVertexAttribPointer
+#undef glViewport
+#define glViewport traced_glViewport
+#undef glCallList
+#define glCallList traced_glCallList
+#undef glDisableClientState
+#define glDisableClientState traced_glDisableClientState
+#undef glEnableClientState
+#define glEnableClientState traced_glEnableClientState
+#undef glLightfv
+#define glLightfv traced_glLightfv
+#undef glLoadIdentity
+#define glLoadIdentity traced_glLoadIdentity
+#undef glMaterialf
+#define glMaterialf traced_glMaterialf
+#undef glMaterialfv
+#define glMaterialfv traced_glMaterialfv
+#undef glMatrixMode
+#define glMatrixMode traced_glMatrixMode
+#undef glMultMatrixf
+#define glMultMatrixf traced_glMultMatrixf
+#undef glNormalPointer
+#define glNormalPointer traced_glNormalPointer
+#undef glPolygonMode
+#define glPolygonMode traced_glPolygonMode
+#undef glPopMatrix
+#define glPopMatrix traced_glPopMatrix
+#undef glPushMatrix
+#define glPushMatrix traced_glPushMatrix
+#undef glRotatef
+#define glRotatef traced_glRotatef
+#undef glScalef
+#define glScalef traced_glScalef
+#undef glShadeModel
+#define glShadeModel traced_glShadeModel
+#undef glTexCoordPointer
+#define glTexCoordPointer traced_glTexCoordPointer
+#undef glTranslatef
+#define glTranslatef traced_glTranslatef
+#undef glVertexPointer
+#define glVertexPointer traced_glVertexPointer
+#endif
+
+#endif
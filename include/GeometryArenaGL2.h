@@ -0,0 +1,104 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_GEOMETRY_ARENA_GL2_H
+#define INITIALS_GEOMETRY_ARENA_GL2_H
+
+#include <vector>
+#include <set>
+#include <inttypes.h>
+#include "Vertex.h"
+
+using namespace std;
+
+class StateCacheGL2;
+
+// Single vertex buffer holding the static geometry of every mesh, so that
+// they can be drawn without switching buffers. Space is handed out by a buddy
+// allocator: blocks are powers of two times MinBlockSize vertices, are split
+// to fit a group and merged back with their buddy when freed. The arena
+// doubles in size when no block is large enough. Vertices are uploaded before
+// the next draw. Since every group in the arena has the same layout, they
+// share the same vertex array objects.
+class GeometryArenaGL2
+{
+public:
+    // modelView is the first of the four locations of the per-instance matrix
+    GeometryArenaGL2(StateCacheGL2 *cache, int position, int normal,
+                     int texCoords, int modelView);
+    ~GeometryArenaGL2();
+
+    void setUseVertexArrays(bool use);
+
+    uint32_t buffer() const;
+    // number of vertices the arena can hold without growing
+    uint32_t capacity() const;
+    // number of vertices in allocated blocks
+    uint32_t used() const;
+
+    // copy the vertices of the group, return the index of its first vertex
+    uint32_t add(const VertexGroup *vg);
+    void remove(uint32_t first, uint32_t count);
+
+    // upload pending vertices and bind the buffer to GL_ARRAY_BUFFER
+    void bind();
+    // bind the buffer and point the vertex attributes to the arena
+    void setAttributes();
+    // bind the vertex array object reading the arena, the per-instance
+    // attributes are enabled but their pointers are left to the caller.
+    // Return false if vertex array objects cannot be used
+    bool bindVertexArray(bool instanced);
+
+    void release();
+
+private:
+    enum
+    {
+        MinBlockSize = 64,
+        InitialOrder = 6
+    };
+
+    static uint32_t blockSize(uint32_t order);
+    static uint32_t blockOrder(uint32_t count);
+    uint32_t allocate(uint32_t order);
+    void grow();
+    bool dirty() const;
+
+    StateCacheGL2 *m_cache;
+    int m_position;
+    int m_normal;
+    int m_texCoords;
+    int m_modelView;
+    bool m_useVertexArrays;
+    uint32_t m_vertexArrays[2];
+    uint32_t m_buffer;
+    uint32_t m_bufferSize;
+    uint32_t m_used;
+    uint32_t m_dirtyStart;
+    uint32_t m_dirtyEnd;
+    // offsets of the free blocks, by order
+    vector< set<uint32_t> > m_freeBlocks;
+    vector<VertexData> m_vertices;
+};
+
+#endif
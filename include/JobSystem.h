@@ -0,0 +1,112 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_JOB_SYSTEM_H
+#define INITIALS_JOB_SYSTEM_H
+
+#include <deque>
+#include <vector>
+#include "Thread.h"
+
+// Threads which run small jobs, shared by every part of the program that
+// works in parallel. Each thread has its own queue of jobs and takes jobs
+// from the others when it runs out. Threads which wait for jobs to finish
+// run queued jobs meanwhile, so jobs can start and wait for other jobs.
+// Threads outside of the system only run the jobs they wait for, so that a
+// thread with a deadline is not held up by the work of another thread.
+class JobSystem
+{
+public:
+    typedef void (*Task)(void *arg, int index);
+    class Counter;
+
+private:
+    typedef struct
+    {
+        Task task;
+        void *arg;
+        int first;
+        int last;                   // indices of the task run by the job
+        Counter *done;
+    } Job;
+
+public:
+    // number of pending jobs, which other jobs can wait for
+    class Counter
+    {
+    public:
+        Counter();
+
+        int pending() const;
+
+    private:
+        friend class JobSystem;
+        volatile int m_pending;
+        std::vector<Job> m_waiting; // jobs queued once nothing is pending
+    };
+
+    JobSystem(int threads);
+    ~JobSystem();
+
+    // the system of the program, with a thread for each processor but one,
+    // since the threads which wait for jobs run them too
+    static JobSystem * shared();
+
+    int threadCount() const;
+
+    // queue task(arg, index). It counts as pending on done, if given, until
+    // it has returned, and only starts once after has no pending jobs.
+    void submit(Task task, void *arg, int index, Counter *done = 0, Counter *after = 0);
+    // run jobs until the counter has no pending jobs left
+    void wait(Counter &counter);
+    // call task(arg, i) for every i in [0, count), in jobs of grain indices,
+    // then wait for them all. By default there are a few jobs per thread.
+    void parallelFor(Task task, void *arg, int count, int grain = 0);
+
+private:
+    typedef struct
+    {
+        Mutex mutex;
+        std::deque<Job> jobs;       // the owner takes from the back, others from the front
+    } Queue;
+
+    static void threadMain(void *arg);
+    void work(int index);
+    int currentQueue() const;
+    void queue(const Job *jobs, int count);
+    bool takeJob(Job &job, const Counter *only = 0);
+    static bool takeJobOf(std::deque<Job> &jobs, const Counter *counter, bool newest, Job &job);
+    void runJob(const Job &job);
+
+    std::vector<Thread> m_threads;  // which keep a pointer to their Thread object
+    std::vector<Queue *> m_queues;  // the last one for threads outside of the system
+    ThreadLocal m_threadIndex;      // one more than the index of a thread of the system
+    Mutex m_mutex;                  // guards the counters and the sleeping threads
+    Condition m_changed;            // a job was queued or a counter went to zero
+    volatile int m_queued;
+    int m_changes;                  // times m_changed was signaled
+    volatile int m_started;
+    bool m_quit;
+};
+
+#endif
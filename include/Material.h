@@ -45,6 +45,9 @@ public:
     void setSpecular(const vec4 &specular);
     void setShine(float shine);
 
+    // identifies the material's parameters, copies share the same ID
+    uint32_t id() const;
+
     uint32_t texture() const;
     void setTexture(uint32_t texture);
     void freeTexture();
@@ -55,6 +58,9 @@ public:
     static uint32_t textureFromTIFFImage(const char *data, size_t size, bool mipmaps = false);
 
 private:
+    static uint32_t nextID();
+
+    uint32_t m_id;
     vec4 m_ambient;
     vec4 m_diffuse;
     vec4 m_specular;
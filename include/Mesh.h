@@ -33,6 +33,7 @@
 using namespace std;
 
 class RenderState;
+class TriangleTree;
 
 class Mesh
 {
@@ -40,12 +41,24 @@ public:
     Mesh();
     virtual ~Mesh();
 
+    // small number identifying the mesh, used to sort draw commands
+    uint32_t id() const;
+
     virtual int groupCount() const = 0;
     virtual uint32_t groupMode(int index) const = 0;
     virtual uint32_t groupSize(int index) const = 0;
     virtual void addGroup(VertexGroup *vg) = 0;
     virtual bool copyGroupTo(int index, VertexGroup *vg) const = 0;
 
+    // bounds of the vertices of every group, updated when a group is added
+    bool hasBounds() const;
+    const vec3 & boundsMin() const;
+    const vec3 & boundsMax() const;
+    const vec3 & boundsCenter() const;
+    float boundsRadius() const;
+    // triangles of every group, for casting rays
+    const TriangleTree * triangles() const;
+
     enum OutputMode
     {
         RenderToScreen,
@@ -64,12 +77,25 @@ public:
     static void saveStl(string path, VertexGroup **vg, int groups);
     static void saveObj(string path, VertexGroup **vg, int groups);
 
+protected:
+    void addBounds(const VertexGroup *vg);
+    void addTriangles(const VertexGroup *vg);
+
 private:
-    static void saveObjIndicesTri(FILE *f, VertexGroup *vg, uint32_t &offset);
-    static void saveObjIndicesQuad(FILE *f, VertexGroup *vg, uint32_t &offset);
-    static void saveObjIndicesTriStrip(FILE *f, VertexGroup *vg, uint32_t &offset);
-    static void saveObjFace(FILE *f, uint32_t ind1, uint32_t ind2, uint32_t ind3);
-    static void saveObjIndice(FILE *f, uint32_t indice);
+    uint32_t m_id;
+    vec3 m_boundsMin;
+    vec3 m_boundsMax;
+    vec3 m_boundsCenter;
+    float m_boundsRadius;       // negative when the mesh has no vertices
+    TriangleTree *m_triangles;
+
+    static void saveObjTask(void *arg, int index);
+    static uint32_t objIndexCount(VertexGroup *vg);
+    static void saveObjIndicesTri(string &out, VertexGroup *vg, uint32_t offset);
+    static void saveObjIndicesQuad(string &out, VertexGroup *vg, uint32_t offset);
+    static void saveObjIndicesTriStrip(string &out, VertexGroup *vg, uint32_t offset);
+    static void saveObjFace(string &out, uint32_t ind1, uint32_t ind2, uint32_t ind3);
+    static void saveObjIndice(string &out, uint32_t indice);
 };
 
 #endif
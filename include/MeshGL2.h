@@ -44,14 +44,19 @@ public:
     virtual void addGroup(VertexGroup *vg);
     virtual bool copyGroupTo(int index, VertexGroup *vg) const;
     virtual void draw(OutputMode mode, RenderState *s, Mesh *output = 0);
+    // draw several instances of the mesh, using per-instance attributes
+    void drawInstances(uint32_t instances);
+
+    // index of the first vertex of the group in the geometry arena
+    uint32_t groupFirst(int index) const;
 
 private:
-    void drawToScreen();
-    void drawArray(VertexGroup *vg, int position, int normal, int texCoords);
-    void drawVBO(VertexGroup *vg, int position, int normal, int texCoords);
+    void drawToScreen(uint32_t instances);
+    static void drawGroup(VertexGroup *vg, uint32_t first, uint32_t instances);
 
     const RenderStateGL2 *m_state;
     std::vector<VertexGroup *> m_groups;
+    std::vector<uint32_t> m_first;
 };
 
 #endif
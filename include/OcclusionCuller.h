@@ -0,0 +1,74 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_OCCLUSION_CULLER_H
+#define INITIALS_OCCLUSION_CULLER_H
+
+#include <map>
+#include <vector>
+#include "Vertex.h"
+
+class Mesh;
+
+// Low-resolution depth buffer, rendered on the CPU from a few large meshes,
+// which tells whether other meshes are hidden behind them. Triangles are drawn
+// at the depth of their farthest vertex, then the edges of the occluders are
+// eroded by a pixel, so that what is seen around them is never reported hidden.
+class OcclusionCuller
+{
+public:
+    OcclusionCuller(int width, int height);
+
+    void begin(const matrix4 &projection);
+    // render the triangles of an occluder seen with the given model-view matrix
+    void addOccluder(Mesh *m, const matrix4 &modelView);
+    void end();
+
+    // whether a sphere, in eye space, is entirely behind the occluders
+    bool isOccluded(const vec3 &center, float radius) const;
+
+    int occluderTriangles() const;
+
+private:
+    enum
+    {
+        TileSize = 8
+    };
+
+    const std::vector<vec3> & meshTriangles(Mesh *m);
+    void drawTriangle(const vec4 *clip);
+    vec4 project(const matrix4 &m, const vec3 &v) const;
+
+    int m_width;
+    int m_height;
+    int m_tilesX;
+    int m_tilesY;
+    matrix4 m_projection;
+    std::vector<float> m_depth;         // depth of the nearest occluder of each pixel
+    std::vector<float> m_eroded;        // scratch buffer for eroding the occluders
+    std::vector<float> m_tileDepth;     // depth of the farthest pixel of each tile
+    std::map<uint32_t, std::vector<vec3> > m_triangles;
+    int m_occluderTriangles;
+};
+
+#endif
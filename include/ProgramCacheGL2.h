@@ -0,0 +1,60 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_PROGRAM_CACHE_GL2_H
+#define INITIALS_PROGRAM_CACHE_GL2_H
+
+#include <string>
+#include <inttypes.h>
+
+using namespace std;
+
+// Keeps the binaries of linked programs on disk (ARB_get_program_binary), so
+// that they do not have to be compiled again on the next launch. Binaries are
+// keyed by the driver and the program's source code.
+class ProgramCacheGL2
+{
+public:
+    ProgramCacheGL2();
+
+    // directory where binaries are stored, caching is disabled when empty
+    void setDirectory(string dir);
+    // the GL context must be current
+    bool enabled();
+
+    // create a program from its cached binary, return 0 if there is none or if
+    // the driver rejected it
+    uint32_t load(const string &source);
+    // save the binary of a program linked with the retrievable hint set
+    void store(uint32_t program, const string &source);
+
+private:
+    string path(const string &identity) const;
+
+    string m_directory;
+    string m_driver;
+    bool m_checked;
+    bool m_supported;
+};
+
+#endif
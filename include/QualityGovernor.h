@@ -0,0 +1,81 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_QUALITY_GOVERNOR_H
+#define INITIALS_QUALITY_GOVERNOR_H
+
+#include <string>
+
+using namespace std;
+
+class RenderState;
+
+// Steps the rendering quality up or down so that frames take about the target
+// time. Quality is lowered as soon as frames are too slow for a while but only
+// raised after a longer period with enough headroom, which gets longer every
+// time a raise had to be undone, so that the quality does not oscillate.
+// Settings are only changed when the level changes, the governor should be
+// disabled when they are changed by hand.
+class QualityGovernor
+{
+public:
+    QualityGovernor(RenderState *state);
+
+    bool enabled() const;
+    void setEnabled(bool enabled);
+    double targetFrameTime() const;
+    void setTargetFrameTime(double seconds);
+
+    // 0 is the highest quality
+    int level() const;
+    int levelCount() const;
+
+    // record how long the last frame took, in seconds
+    void frameFinished(double frameTime);
+    // change the settings to those of the current level, e.g. after a reset
+    void apply();
+
+    string statusText() const;
+
+private:
+    enum
+    {
+        DefaultLevel = 1,
+        WindowFrames = 20,      // frames averaged before taking a decision
+        MinRaiseDelay = 3,      // fast windows needed before raising quality
+        MaxRaiseDelay = 48
+    };
+
+    RenderState *m_state;
+    bool m_enabled;
+    double m_target;
+    int m_level;
+    double m_windowTime;
+    int m_windowFrames;
+    double m_average;
+    int m_fastWindows;
+    int m_raiseDelay;
+    int m_windowsSinceRaise;
+};
+
+#endif
@@ -26,12 +26,43 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include "Mesh.h"
 #include "Material.h"
 #include "Vertex.h"
 
 using namespace std;
 
+// A transform value which follows an animated parameter: base + factor * param.
+class Binding
+{
+public:
+    Binding(double value = 0.0);
+    Binding(const float *param, double factor, double base);
+
+    float value() const;
+
+    const float *param;
+    double factor;
+    double base;
+};
+
+Binding bind(const float &param, double factor = 1.0, double base = 0.0);
+
+// Reference to a mesh of a render state, which is resolved without looking up
+// its name. A handle is stale once its mesh has been freed and then resolves
+// to no mesh, even if its slot has been reused for another mesh.
+class MeshHandle
+{
+public:
+    MeshHandle();
+
+    bool isNull() const;
+
+    uint32_t index;
+    uint32_t generation;        // zero for null handles
+};
+
 class RenderState
 {
 public:
@@ -44,12 +75,47 @@ public:
     virtual void toggleNormals();
     virtual void toggleWireframe();
     virtual void toggleProjection();
+    // compute the lighting per pixel instead of per vertex, if supported
+    virtual bool perPixelLighting() const;
+    virtual void setPerPixelLighting(bool enabled);
+    // antialias the scene when the framebuffer has sample buffers
+    virtual bool multisampling() const;
+    virtual void setMultisampling(bool enabled);
+    // render the scene at a fraction of the viewport size, if supported
+    virtual float renderScale() const;
+    virtual void setRenderScale(float scale);
+    // number of frames the GPU may be drawing when a frame begins, this one
+    // included, from 1 to 3. States without fences finish frames in order.
+    virtual int frameLatency() const;
+    virtual void setFrameLatency(int frames);
 
     virtual void reset();
 
+    enum SubmitMode
+    {
+        Immediate,              // draw meshes as soon as drawMesh is called
+        DeferredByState,        // record meshes, sort them by state at the end of the frame
+        DeferredFrontToBack     // record meshes, sort them by depth at the end of the frame
+    };
+
+    virtual SubmitMode submitMode() const;
+    virtual void setSubmitMode(SubmitMode mode);
+
+    // human-readable counters about the last frame, if the backend keeps any
+    virtual string frameStatistics() const;
+
     // mesh operations
     virtual void drawMesh(Mesh *m) = 0;
-    virtual void drawMesh(string name);
+    virtual void drawMesh(MeshHandle h);
+    // slow path, which looks up the mesh by name
+    virtual void drawMesh(const string &name);
+
+    // take a reference to a mesh, which keeps it alive until it is released
+    MeshHandle acquireMesh(const string &name);
+    void releaseMesh(MeshHandle h);
+    Mesh * mesh(MeshHandle h) const;
+    // forget the name of a mesh, which is freed once every handle is released
+    void removeMesh(const string &name);
 
     virtual void beginExportMesh(string path);
     virtual void endExportMesh();
@@ -65,7 +131,7 @@ public:
 
     virtual uint32_t loadTextureFromFile(string name, string path, bool mipmaps = false);
     virtual uint32_t loadTextureFromData(string name, const char *data, size_t size, bool mipmaps = false);
-    virtual uint32_t texture(string name) const;
+    virtual uint32_t texture(const string &name) const;
     virtual void freeTextures() = 0;
 
     // matrix operations
@@ -89,6 +155,12 @@ public:
     virtual void scale(float sx, float sy, float sz) = 0;
 
     virtual matrix4 currentMatrix() const = 0;
+    // identity by default, for states which do not project anything
+    virtual matrix4 projectionMatrix() const;
+
+    // transforms with animated values, which are evaluated right away by default
+    virtual void translateAnimated(const Binding &dx, const Binding &dy, const Binding &dz);
+    virtual void rotateAnimated(const Binding &angle, float rx, float ry, float rz);
 
     // general state operations
     virtual void beginFrame(int width, int heigth) = 0;
@@ -99,8 +171,17 @@ public:
 
     virtual void pushMaterial(const Material &m) = 0;
     virtual void popMaterial() = 0;
+    // prepare the state of a material in advance so it is cheap to switch to
+    virtual void registerMaterial(const Material &m);
+
+    // name the meshes drawn from now on, to tell what was picked. Only the
+    // innermost name is kept, the default is to ignore names.
+    virtual void pushName(int name);
+    virtual void popName();
 
 protected:
+    void freeMeshSlot(uint32_t index);
+
     Mesh::OutputMode m_output;
     bool m_drawNormals;
     bool m_projection;
@@ -110,6 +191,17 @@ protected:
     map<string, uint32_t> m_textures;
     map<string, Mesh *> m_meshes;
 
+    typedef struct
+    {
+        Mesh *mesh;
+        uint32_t generation;
+        uint32_t refs;          // the name of the mesh holds a reference too
+    } MeshSlot;
+
+    vector<MeshSlot> m_meshSlots;
+    vector<uint32_t> m_freeMeshSlots;
+    map<string, uint32_t> m_meshSlotNames;
+
     // exporting
     bool m_exporting;
     string m_exportPath;
@@ -121,6 +213,9 @@ class StateObject
 public:
     StateObject(RenderState *s);
 
+    RenderState * state() const;
+    void setState(RenderState *s);
+
     void loadIdentity();
     void pushMatrix();
     void popMatrix();
@@ -128,13 +223,19 @@ public:
     void translate(float dx, float dy, float dz);
     void rotate(float angle, float rx, float ry, float rz);
     void scale(float sx, float sy, float sz);
+    void translate(const Binding &dx, const Binding &dy, const Binding &dz);
+    void rotate(const Binding &angle, float rx, float ry, float rz);
 
     void drawMesh(Mesh *m);
-    void drawMesh(string name);
+    void drawMesh(MeshHandle h);
+    void drawMesh(const string &name);
 
     void pushMaterial(const Material &m);
     void popMaterial();
 
+    void pushName(int name);
+    void popName();
+
 protected:
     RenderState *m_state;
 };
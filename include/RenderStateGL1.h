@@ -25,12 +25,14 @@
 #define INITIALS_RENDER_STATE_GL1_H
 
 #include <vector>
+#include <map>
 #include "RenderState.h"
 
 class RenderStateGL1 : public RenderState
 {
 public:
     RenderStateGL1();
+    virtual ~RenderStateGL1();
 
     virtual Mesh * createMesh() const;
     virtual void drawMesh(Mesh *m);
@@ -49,15 +51,18 @@ public:
     virtual void scale(float sx, float sy, float sz);
 
     virtual matrix4 currentMatrix() const;
+    virtual matrix4 projectionMatrix() const;
 
     // general state operations
     virtual void beginFrame(int width, int heigth);
     virtual void setupViewport(int width, int heigth);
     virtual void endFrame();
+    virtual string frameStatistics() const;
 
     // material operations
     virtual void pushMaterial(const Material &m);
     virtual void popMaterial();
+    virtual void registerMaterial(const Material &m);
 
 private:
     void beginApplyMaterial(const Material &m);
@@ -68,6 +73,7 @@ private:
     vec4 m_specular0;
     vec4 m_light0_pos;
     std::vector<Material> m_materialStack;
+    std::map<uint32_t, uint32_t> m_materialLists;
 };
 
 #endif
@@ -26,9 +26,16 @@
 
 #include <vector>
 #include <string>
+#include <map>
 #include <inttypes.h>
 #include "RenderState.h"
 
+class StateCacheGL2;
+class DrawList;
+class StreamBufferGL2;
+class GeometryArenaGL2;
+class ProgramCacheGL2;
+
 class RenderStateGL2 : public RenderState
 {
 public:
@@ -54,6 +61,7 @@ public:
     virtual void scale(float sx, float sy, float sz);
 
     virtual matrix4 currentMatrix() const;
+    virtual matrix4 projectionMatrix() const;
 
     // general state operations
     virtual void beginFrame(int width, int heigth);
@@ -63,20 +71,130 @@ public:
     // material operations
     virtual void pushMaterial(const Material &m);
     virtual void popMaterial();
+    virtual void registerMaterial(const Material &m);
+
+    virtual SubmitMode submitMode() const;
+    virtual void setSubmitMode(SubmitMode mode);
+    virtual string frameStatistics() const;
+    virtual bool perPixelLighting() const;
+    virtual void setPerPixelLighting(bool enabled);
+    virtual bool multisampling() const;
+    virtual void setMultisampling(bool enabled);
+    virtual float renderScale() const;
+    virtual void setRenderScale(float scale);
+    virtual int frameLatency() const;
+    virtual void setFrameLatency(int frames);
+
+    // mask of the vertex attributes read by the current program
+    uint32_t attributeMask() const;
+    StateCacheGL2 * cache() const;
+    GeometryArenaGL2 * arena() const;
 
-    int positionAttr() const;
-    int normalAttr() const;
-    int texCoordsAttr() const;
+    // whether draws of the same mesh and material are batched together
+    bool instancing() const;
+    // whether batches are submitted with one multi-draw per material
+    bool indirect() const;
+    // whether the light and material parameters are kept in uniform buffers
+    bool uniformBlocks() const;
+    // directory where linked programs are cached, must be set before init()
+    void setProgramCacheDir(string dir);
 
 private:
-    void beginApplyMaterial(const Material &m);
-    void endApplyMaterial(const Material &m);
-    uint32_t loadShader(string path, uint32_t type) const;
+    enum Uniform
+    {
+        ModelViewMatrix,
+        ProjectionMatrix,
+        LightAmbient,
+        LightDiffuse,
+        LightSpecular,
+        LightPosition,
+        MaterialAmbient,
+        MaterialDiffuse,
+        MaterialSpecular,
+        MaterialShine,
+        MaterialTexture,
+        UniformCount
+    };
+
+    enum Attribute
+    {
+        PositionAttr = 0,
+        NormalAttr = 1,
+        TexCoordsAttr = 2,
+        ModelViewAttr = 3       // per-instance matrix, uses four locations
+    };
+
+    // binding points of the std140 uniform blocks
+    enum UniformBlock
+    {
+        FrameBlock = 0,
+        MaterialBlock = 1
+    };
+
+    // features a shader program is specialized for, each combination is a
+    // separate program variant
+    enum ShaderFeature
+    {
+        TexturedFeature = 1,
+        PerPixelFeature = 2,
+        InstancedFeature = 4,
+        VariantCount = 8
+    };
+
+    enum
+    {
+        MaxFrameLatency = 3     // as many frames as the stream buffers have regions
+    };
+
+    // consecutive batches drawn with the same material
+    typedef struct
+    {
+        uint32_t material;      // index in the draw list
+        uint32_t program;       // variant used by the material
+        uint32_t mode;
+        uint32_t start;         // first indirect command
+        uint32_t count;
+    } MaterialRun;
+
+    typedef struct
+    {
+        uint32_t program;
+        uint32_t vertexShader;
+        uint32_t pixelShader;
+        int uniforms[UniformCount];
+        uint32_t attributes;    // mask of the vertex attributes used
+        uint32_t frame;         // last frame the light was set in
+        uint32_t projection;    // version of the projection matrix last set
+    } ProgramInfo;
+
+    uint32_t programVariant(const Material &m) const;
+    void useProgram(uint32_t variant);
+    void applyMaterial(const Material &m);
+    void drawMeshNow(Mesh *m, const matrix4 &modelView);
+    void submitDrawList();
+    void submitInstanced();
+    void submitIndirect();
+    void setInstanceAttributes(size_t offset);
+    void waitFrames(uint32_t frame);
+    void fenceFrame(uint32_t frame);
+    void releaseFences();
+    bool bindRenderTarget(int width, int height);
+    void freeRenderTarget();
+    void drawRenderTarget();
+    uint32_t loadShader(const string &code, uint32_t type, string defines) const;
+    uint32_t linkProgram(const string &vertexCode, const string &pixelCode, string defines,
+                         uint32_t &vertexShader, uint32_t &pixelShader) const;
+    bool loadProgram(uint32_t variant, string defines);
     bool loadShaders();
-    void initShaders();
-    void setUniformValue(string name, const vec4 &v);
-    void setUniformValue(string name, float f);
-    void setUniformValue(string name, int i);
+    bool loadUpscaleProgram();
+    bool loadUniformBuffers();
+    void updateFrameBlock();
+    uint32_t materialOffset(const Material &m);
+    void freeShaders();
+    void setUniformValue(Uniform u, const vec4 &v);
+    void setUniformValue(Uniform u, float f);
+    void setUniformValue(Uniform u, int i);
+    void setUniformValue(Uniform u, const matrix4 &m);
 
     vec4 m_ambient0;
     vec4 m_diffuse0;
@@ -86,14 +204,55 @@ private:
     RenderState::MatrixMode m_matrixMode;
     matrix4 m_matrix[3];
     std::vector<matrix4> m_matrixStack[3];
-    uint32_t m_vertexShader;
-    uint32_t m_pixelShader;
-    uint32_t m_program;
-    int m_modelViewMatrixLoc;
-    int m_projMatrixLoc;
-    int m_positionAttr;
-    int m_normalAttr;
-    int m_texCoordsAttr;
+    ProgramInfo m_programs[VariantCount];
+    ProgramInfo *m_program;
+    ProgramCacheGL2 *m_programCache;
+    uint32_t m_frame;
+    uint32_t m_projectionVersion;
+    StateCacheGL2 *m_cache;
+    SubmitMode m_submitMode;
+    DrawList *m_drawList;
+    Material m_defaultMaterial;
+    bool m_instancing;
+    bool m_perPixelLighting;
+    bool m_multisampling;
+    float m_renderScale;
+    // offscreen framebuffer used when the render scale is below one
+    uint32_t m_renderTarget;
+    uint32_t m_renderTargetColor;  // texture, drawn to the viewport on a quad
+    uint32_t m_renderTargetDepth;
+    int m_renderTargetWidth;
+    int m_renderTargetHeight;
+    bool m_scaled;
+    bool m_renderTargetFailed;      // the scene is always drawn at full size
+    uint32_t m_upscaleProgram;
+    uint32_t m_upscaleVertexShader;
+    uint32_t m_upscalePixelShader;
+    uint32_t m_upscaleBuffer;
+    int m_frameWidth;
+    int m_frameHeight;
+    int m_frameLatency;
+    void *m_frameFences[MaxFrameLatency];   // GLsync objects, by frame
+    uint32_t m_fencedFrames[MaxFrameLatency];
+    // enable state of the context before the frame, restored at the end
+    bool m_depthTestEnabled;
+    bool m_multisampleEnabled;
+    StreamBufferGL2 *m_instanceStream;
+    bool m_indirect;
+    StreamBufferGL2 *m_indirectStream;
+    std::vector<uint32_t> m_indirectData;
+    std::vector<MaterialRun> m_runs;
+    GeometryArenaGL2 *m_arena;
+    uint32_t m_batches;
+    bool m_uniformBlocks;
+    uint32_t m_frameBuffer;
+    uint32_t m_frameBufferFrame;
+    uint32_t m_frameBufferProjection;
+    uint32_t m_materialBuffer;
+    uint32_t m_materialStride;
+    uint32_t m_materialCapacity;
+    std::vector<char> m_materialData;
+    std::map<uint32_t, uint32_t> m_materialOffsets;
 };
 
 #endif
@@ -27,13 +27,22 @@
 #include <vector>
 #include "RenderState.h"
 #include "Vertex.h"
+#include "BoundingVolumeHierarchy.h"
+#include "AnimationCurve.h"
+#include "JobSystem.h"
 
 class Dragon;
+class DragonPoses;
+class DrawRecorder;
+class SceneNode;
+class OcclusionCuller;
 
 class Scene : public StateObject
 {
 public:
-    Scene(RenderState *state);
+    // a crowd size above zero replaces the three dragons of the demo with
+    // that many randomized ones, which is used to stress the renderer
+    Scene(RenderState *state, int crowdSize = 0);
     virtual ~Scene();
 
     bool isLoaded() const { return m_loaded; }
@@ -45,6 +54,11 @@ public:
     vec3 & delta();
 
     void draw();
+    // start on the next frame in a job, while the GPU draws this one. The
+    // retained scene is updated and culled for the camera as it is now, the
+    // immediate one records the dragons. What was prepared is used by the
+    // next draw, unless the poses, the camera or the settings change before.
+    void prepareFrame();
 
     void selectNext();
     void selectPrevious();
@@ -70,6 +84,22 @@ public:
     Camera camera() const;
     void setCamera(Camera c);
 
+    // draw the scene from nodes built once instead of running the scripts
+    bool retained() const;
+    void setRetained(bool enabled);
+
+    // skip the parts of the retained scene which are out of view
+    bool culling() const;
+    void setCulling(bool enabled);
+    // also skip the parts which are hidden behind large meshes
+    bool occlusionCulling() const;
+    void setOcclusionCulling(bool enabled);
+
+    int crowdSize() const;
+
+    // human-readable counters about the last frame
+    string statistics() const;
+
     enum Item
     {
         SCENE,
@@ -98,15 +128,76 @@ public:
     void exportItem(Item item, string path);
     void animate();
 
+    // seconds since the animation started, as given to simulate
+    double elapsed() const;
+    const DragonPoses & poses() const;
+    // compute the poses of the dragons at time t and the angle the camera
+    // follows, without changing the scene. Can be called from any thread.
+    void simulate(double t, DragonPoses &poses, float &angle) const;
+    // show poses part of the way from one to the other
+    void showPoses(const DragonPoses &from, const DragonPoses &to, float f, float angle);
+    // the curves of the flying and jumping dragons, before they are baked
+    static const AnimationCurve::Source * curveSources(int &count);
+
+    typedef struct
+    {
+        Item item;                  // SCENE when no dragon was hit
+        int dragon;                 // negative when no dragon was hit
+        float distance;             // from the near plane, in eye space
+    } PickResult;
+
+    // find what is drawn at a point of the viewport, given from -1 to 1
+    // in both directions. Casts a ray through the retained scene.
+    PickResult pick(float x, float y);
+    Item selected() const;
+    void select(Item item);
+
 private:
     void drawItem(Item item);
+    void buildNodes();
+    void freeNodes();
+    void addOccluders(SceneNode *n, std::vector<SceneNode *> &occluders);
     void drawScene();
+    static void recordDragonsTask(void *arg, int index);
+    static void prepareNodesTask(void *arg, int index);
+    void discardPrepared();
+    matrix4 viewMatrix() const;
+    int updateNodes(const matrix4 &view);
+    void cullNodes();
+    void drawNodes(bool prepared);
+    static void updateNodeTask(void *arg, int index);
+    void updateNode(int index);
+    static void drawDragonTask(void *arg, int index);
+    void drawDragon(int index);
+    void drawCrowdDragon(int index);
+    void spawnCrowd(int count);
+    void followAngle(float angle);
     void drawFloor();
     void drawDragonHoldingA(Dragon *d);
     void drawDragonHoldingP(Dragon *d);
     void drawDragonHoldingS(Dragon *d);
     static string itemText(Item item);
 
+    enum SceneMesh
+    {
+        FloorMesh,
+        LetterPMesh,
+        LetterAMesh,
+        LetterSMesh,
+        ChestMesh,
+        MeshCount
+    };
+
+    // where a dragon of the crowd is and what it looks like
+    typedef struct
+    {
+        vec3 position;
+        float heading;
+        float size;
+        int letter;
+        int variant;
+    } CrowdPlacement;
+
     double m_started;
     int m_selected;
     int m_detailLevel;
@@ -117,6 +208,50 @@ private:
     vec3 m_thetaCamera;
     Dragon *m_debugDragon;
     std::vector<Dragon *> m_dragons;
+    DragonPoses *m_poses;           // of every dragon but the debug one
+    AnimationCurve m_flyingCurve;
+    AnimationCurve m_jumpingCurve;
+    std::vector<CrowdPlacement> m_crowd;
+    MeshHandle m_meshes[MeshCount];
+    std::vector<DrawRecorder *> m_recorders;
+    JobSystem *m_jobs;
+    JobSystem::Counter m_preparation;
+    bool m_preparing;               // a job works on the next frame
+    bool m_prepared;                // it was started for the next frame
+    std::vector<SceneNode *> m_nodes;
+    std::vector<int> m_nodeUpdates;
+    matrix4 m_view;
+    matrix4 m_nodeView;             // view the nodes were last updated with
+    matrix4 m_preparedView;         // the next frame is expected to have
+    matrix4 m_cullProjection;       // the visible nodes were found with
+    Frustum m_nodeFrustum;
+    bool m_viewChanged;
+    bool m_retained;
+    bool m_culling;
+    bool m_occlusion;
+    bool m_exporting;
+    // occluders of each tree of nodes
+    std::vector<std::vector<SceneNode *> > m_occluders;
+    BoundingVolumeHierarchy m_nodeTree;
+    std::vector<BoundingVolumeHierarchy::Bounds> m_nodeBounds;
+    std::vector<BoundingVolumeHierarchy::Visible> m_visibleNodes;
+    std::vector<BoundingVolumeHierarchy::RayHit> m_rayHits;
+    OcclusionCuller *m_occlusionCuller;
+    int m_preparedUpdates;          // nodes the job updated
+    int m_cullOutside;
+    int m_cullOccluded;
+    // counters of the last frame drawn from the nodes, while a job can work
+    // on the next one
+    int m_nodesUpdated;
+    int m_meshesOutside;
+    int m_meshesOccluded;
+    int m_treeSpheres;
+    int m_treeBuilds;
+    int m_occluderTriangles;
+    PickResult m_lastPick;
+    double m_pickTime;
+    double m_animationTime;
+    double m_drawTime;
     bool m_exportQueued;
     bool m_loaded;
 };
@@ -0,0 +1,181 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_SCENE_GRAPH_H
+#define INITIALS_SCENE_GRAPH_H
+
+#include <vector>
+#include "RenderState.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+
+// Node of the retained scene, built once from the drawing scripts. The local
+// transform of a node is kept as the sequence of transforms the script made,
+// some of which follow animated parameters. The world matrix is cached and
+// only computed again when one of these parameters or the parent changed.
+class SceneNode
+{
+public:
+    SceneNode(SceneNode *parent = 0);
+    ~SceneNode();
+
+    SceneNode * parent() const;
+    const vector<SceneNode *> & children() const;
+    SceneNode * addChild();
+
+    void multiplyMatrix(const matrix4 &m);
+    void translate(const Binding &dx, const Binding &dy, const Binding &dz);
+    void rotate(const Binding &angle, float rx, float ry, float rz);
+    void scale(float sx, float sy, float sz);
+
+    Mesh * mesh() const;
+    void setMesh(Mesh *m);
+    // the material is used by the whole subtree and must outlive the node
+    const Material * material() const;
+    void setMaterial(const Material *m);
+    // name the mesh was drawn with, negative when there was none
+    int name() const;
+    void setName(int name);
+
+    const matrix4 & worldMatrix() const;
+    // sphere around the meshes of the subtree, negative radius when there are none
+    const vec3 & boundsCenter() const;
+    float boundsRadius() const;
+    int meshCount() const;
+
+    // compute the world matrices and bounds which are out of date in this
+    // subtree, returns the number of nodes which were updated
+    int update(const matrix4 &parentWorld, bool parentChanged);
+    // meshes which were not drawn
+    typedef struct
+    {
+        int outside;
+        int occluded;
+    } CullCounts;
+
+    void draw(RenderState *s) const;
+    // only draw the meshes which are not outside of the frustum nor behind
+    // the occluders, when there are any
+    void draw(RenderState *s, const Frustum *frustum, const OcclusionCuller *occlusion,
+              CullCounts &counts) const;
+
+    // find the nearest mesh of the subtree hit by the ray, if it is closer
+    // than distance. The ray is in the same space as the world matrices.
+    bool intersect(const vec3 &origin, const vec3 &direction, float &distance,
+                   const SceneNode *&hit) const;
+
+private:
+    enum TransformKind
+    {
+        Matrix,
+        Translation,
+        Rotation,
+        Scaling
+    };
+
+    typedef struct
+    {
+        TransformKind kind;
+        Binding x, y, z;            // angle in x, axis in (rx, ry, rz) for rotations
+        vec3 axis;
+        float last[3];              // parameter values the matrix was computed with
+        matrix4 matrix;
+    } Transform;
+
+    void addTransform(const Transform &t);
+    bool updateTransform(Transform &t);
+    static void computeTransform(Transform &t);
+    void setAnimated();
+    void updateBounds();
+
+    SceneNode *m_parent;
+    vector<SceneNode *> m_children;
+    vector<Transform> m_transforms;
+    Mesh *m_mesh;
+    const Material *m_material;
+    int m_name;
+    matrix4 m_world;
+    vec3 m_meshCenter;
+    float m_meshRadius;
+    vec3 m_center;
+    float m_radius;
+    int m_meshCount;                // number of meshes in the subtree
+    bool m_dirty;
+    bool m_animated;                // some transform in the subtree is animated
+};
+
+// Builds scene nodes from the drawing scripts of the scene, by being the state
+// they draw with. Transforms which follow animated parameters stay bound.
+class SceneBuilder : public RenderState
+{
+public:
+    SceneBuilder(const RenderState *target);
+
+    // add the nodes which are drawn from now on as children of root
+    void begin(SceneNode *root);
+    void end();
+
+    virtual Mesh * createMesh() const;
+    virtual void drawMesh(Mesh *m);
+    virtual void drawMesh(MeshHandle h);
+    virtual void drawMesh(const string &name);
+    virtual void freeTextures();
+
+    // matrix operations
+    virtual void setMatrixMode(MatrixMode newMode);
+
+    virtual void loadIdentity();
+    virtual void multiplyMatrix(const matrix4 &m);
+    virtual void pushMatrix();
+    virtual void popMatrix();
+
+    virtual void translate(float dx, float dy, float dz);
+    virtual void rotate(float angle, float rx, float ry, float rz);
+    virtual void scale(float sx, float sy, float sz);
+
+    virtual matrix4 currentMatrix() const;
+
+    virtual void translateAnimated(const Binding &dx, const Binding &dy, const Binding &dz);
+    virtual void rotateAnimated(const Binding &angle, float rx, float ry, float rz);
+
+    // general state operations
+    virtual void beginFrame(int width, int heigth);
+    virtual void setupViewport(int width, int heigth);
+    virtual void endFrame();
+
+    // material operations
+    virtual void pushMaterial(const Material &m);
+    virtual void popMaterial();
+
+    virtual void pushName(int name);
+    virtual void popName();
+
+private:
+    SceneNode * transformedNode();
+
+    const RenderState *m_target;
+    vector<SceneNode *> m_stack;
+    vector<int> m_names;
+};
+
+#endif
@@ -33,6 +33,8 @@ class QPainter;
 class QGLFormat;
 class Scene;
 class RenderState;
+class QualityGovernor;
+class Simulation;
 
 typedef struct
 {
@@ -67,19 +69,28 @@ private slots:
 
 private:
     void paintFPS(QPainter *p, float fps);
+    void paintStats(QPainter *p, QString stats);
     void startFPS();
     void updateAnimationState();
     void toggleAnimation();
+    void cycleSubmitMode();
+    void toggleTrace();
+    void toggleGovernor();
     void resetCamera();
+    void pickItem(int x, int y);
 
     Scene *m_scene;
     RenderState *m_state;
     QTimer *m_renderTimer;
+    QualityGovernor *m_governor;
+    Simulation *m_simulation;
+    QTime m_frameTime;
 
     // viewer settings
     MouseState m_transState;
     MouseState m_rotState;
     bool m_animate;
+    bool m_showStats;
 
     // FPS settings
     QTimer *m_fpsTimer;
@@ -0,0 +1,89 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_SIMULATION_H
+#define INITIALS_SIMULATION_H
+
+#include "DragonPoses.h"
+#include "Thread.h"
+#include "TripleBuffer.h"
+
+class Scene;
+
+// Animation of a scene at a fixed rate on its own thread, whatever the frame
+// rate is. Each step is computed from its own time only, so that it is the
+// same on every run. Every step is published along with the one before, and
+// the renderer shows the poses interpolated between the two, one step behind,
+// without ever waiting for the thread.
+class Simulation
+{
+public:
+    Simulation(Scene *scene, double step = 1.0 / 60.0);
+    ~Simulation();
+
+    double step() const;
+    bool running() const;
+    // catch up with the time of the scene, then keep up with it
+    void start();
+    void stop();
+
+    // give the scene the poses of the current time
+    void apply();
+
+private:
+    struct Snapshot
+    {
+        Snapshot(const DragonPoses &p) : time(0.0), angle(0.0), poses(p)
+        {
+        }
+
+        double time;
+        float angle;
+        DragonPoses poses;
+    };
+
+    struct Steps
+    {
+        Steps(const DragonPoses &p) : previous(p), current(p)
+        {
+        }
+
+        Snapshot previous;
+        Snapshot current;
+    };
+
+    static void threadMain(void *arg);
+    void run();
+    void simulateStep(long step);
+
+    Scene *m_scene;
+    double m_step;
+    long m_lastStep;                // only used by the thread once started
+    Snapshot m_last;                // the same
+    Thread m_thread;
+    volatile bool m_quit;
+    bool m_running;
+    TripleBuffer<Steps> m_buffer;
+};
+
+#endif
@@ -0,0 +1,102 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_STATE_CACHE_GL2_H
+#define INITIALS_STATE_CACHE_GL2_H
+
+#include <string>
+#include <inttypes.h>
+
+using namespace std;
+
+// Shadow copy of the GL state touched by the GL2 backend. Calls which would
+// not change the current state are not sent to the driver.
+class StateCacheGL2
+{
+public:
+    StateCacheGL2();
+
+    enum Category
+    {
+        ProgramState,
+        BufferState,
+        TextureState,
+        AttributeState,
+        MaterialState,
+        CategoryCount
+    };
+
+    typedef struct
+    {
+        uint32_t issued[CategoryCount];
+        uint32_t skipped[CategoryCount];
+    } Stats;
+
+    // forget what we know about the GL state (someone else used the context)
+    void invalidate();
+    // restore the default GL state, e.g. before handing the context to Qt
+    void reset();
+
+    void useProgram(uint32_t program);
+    void bindBuffer(uint32_t target, uint32_t buffer);
+    void deleteBuffer(uint32_t buffer);
+    void bindVertexArray(uint32_t array);
+    void deleteVertexArray(uint32_t array);
+    void activeTexture(uint32_t unit);
+    void bindTexture(uint32_t target, uint32_t texture);
+    void deleteTexture(uint32_t texture);
+
+    // enable exactly the vertex attributes whose location bit is set in mask,
+    // in the default vertex array which is bound if needed
+    void enableAttributes(uint32_t mask);
+
+    // return true if the material needs to be applied
+    bool setMaterial(uint32_t id);
+
+    const Stats & stats() const;
+    void clearStats();
+    string statsText() const;
+
+private:
+    enum
+    {
+        MaxBufferTargets = 2,
+        MaxTextureUnits = 8,
+        Unknown = 0xffffffff
+    };
+
+    static int bufferTargetIndex(uint32_t target);
+    void count(Category c, bool issued);
+
+    uint32_t m_program;
+    uint32_t m_buffers[MaxBufferTargets];
+    uint32_t m_vertexArray;
+    uint32_t m_activeTexture;
+    uint32_t m_textures[MaxTextureUnits];
+    uint32_t m_attributes;
+    bool m_attributesKnown;
+    uint32_t m_material;
+    Stats m_stats;
+};
+
+#endif
@@ -0,0 +1,79 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_STREAM_BUFFER_GL2_H
+#define INITIALS_STREAM_BUFFER_GL2_H
+
+#include <vector>
+#include <cstddef>
+#include <inttypes.h>
+
+using namespace std;
+
+class StateCacheGL2;
+
+// Vertex buffer rewritten by the CPU every frame. It is split in regions which
+// are used in turn, so that one frame can be written while the GPU is still
+// reading the previous ones. With ARB_buffer_storage the buffer stays mapped
+// and fences keep us from overwriting a region in use, otherwise the data is
+// uploaded with glBufferSubData.
+class StreamBufferGL2
+{
+public:
+    StreamBufferGL2(StateCacheGL2 *cache);
+    ~StreamBufferGL2();
+
+    uint32_t buffer() const;
+    bool persistent() const;
+
+    // return memory where size bytes can be written until commit() is called
+    void * map(size_t size);
+    // make the written data visible to the GPU, return its offset in the buffer
+    size_t commit();
+    // call after the commands which read the committed data have been issued
+    void fence();
+
+    void release();
+
+private:
+    enum
+    {
+        RegionCount = 3,
+        MinRegionSize = 4096
+    };
+
+    bool allocate(size_t regionSize);
+    void waitRegion(uint32_t region);
+
+    StateCacheGL2 *m_cache;
+    uint32_t m_buffer;
+    bool m_persistent;
+    char *m_mapped;
+    size_t m_regionSize;
+    size_t m_size;
+    uint32_t m_region;
+    void *m_fences[RegionCount];     // GLsync objects
+    vector<char> m_staging;
+};
+
+#endif
@@ -0,0 +1,131 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_THREAD_H
+#define INITIALS_THREAD_H
+
+#include <vector>
+
+#ifdef WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+class Mutex
+{
+public:
+    Mutex();
+    ~Mutex();
+
+    void lock();
+    void unlock();
+
+private:
+    friend class Condition;
+#ifdef WIN32
+    CRITICAL_SECTION m_mutex;
+#else
+    pthread_mutex_t m_mutex;
+#endif
+};
+
+class Condition
+{
+public:
+    Condition();
+    ~Condition();
+
+    // the mutex must be locked by the calling thread
+    void wait(Mutex &m);
+    void signal();
+    void broadcast();
+
+private:
+#ifdef WIN32
+    CONDITION_VARIABLE m_cond;
+#else
+    pthread_cond_t m_cond;
+#endif
+};
+
+class Thread
+{
+public:
+    typedef void (*Function)(void *arg);
+
+    Thread();
+
+    bool start(Function f, void *arg);
+    void join();
+
+private:
+#ifdef WIN32
+    static DWORD WINAPI threadMain(LPVOID param);
+    HANDLE m_thread;
+#else
+    static void * threadMain(void *param);
+    pthread_t m_thread;
+    bool m_started;
+#endif
+    Function m_function;
+    void *m_arg;
+};
+
+// Pointer which has its own value in every thread, null until it is set.
+class ThreadLocal
+{
+public:
+    ThreadLocal();
+    ~ThreadLocal();
+
+    void * get() const;
+    void set(void *value);
+
+private:
+#ifdef WIN32
+    DWORD m_key;
+#else
+    pthread_key_t m_key;
+#endif
+};
+
+// number of processors which can run threads
+int processorCount();
+
+// suspend the calling thread, as precisely as the system timer allows
+void sleepFor(double seconds);
+
+// store value and return the previous one at once, with the memory accesses
+// made before and after the exchange staying on their side of it
+int atomicExchange(volatile int *target, int value);
+// add to an integer shared between threads and return the new value, ordered
+// the same way
+int atomicAdd(volatile int *target, int value);
+
+#endif
@@ -0,0 +1,63 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_TRIANGLE_TREE_H
+#define INITIALS_TRIANGLE_TREE_H
+
+#include <vector>
+#include "Vertex.h"
+
+// Tree of boxes over the triangles of a mesh, to find where rays hit it
+// without testing every triangle.
+class TriangleTree
+{
+public:
+    TriangleTree();
+
+    // positions of the triangles, three by three
+    void build(const std::vector<vec3> &positions);
+    const std::vector<vec3> & positions() const;
+
+    // find the nearest triangle hit by the ray which is closer than distance,
+    // which is then updated. Distances are measured in lengths of the
+    // direction, so that they stay the same when the ray is transformed.
+    bool intersect(const vec3 &origin, const vec3 &direction, float &distance) const;
+
+private:
+    typedef struct
+    {
+        vec3 low;
+        vec3 high;
+        int first;                  // first triangle of a leaf, else the right child
+        int count;                  // triangles of a leaf, zero otherwise
+    } Node;
+
+    int buildNode(std::vector<int> &order, int first, int last, const std::vector<vec3> &centers);
+    bool intersectBox(const Node &n, const vec3 &origin, const vec3 &inverse, float distance) const;
+    bool intersectTriangle(int index, const vec3 &origin, const vec3 &direction, float &distance) const;
+
+    std::vector<Node> m_nodes;      // the left child follows its parent
+    std::vector<vec3> m_positions;  // sorted by leaf
+};
+
+#endif
@@ -0,0 +1,82 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef INITIALS_TRIPLE_BUFFER_H
+#define INITIALS_TRIPLE_BUFFER_H
+
+#include <vector>
+#include "Thread.h"
+
+// Three copies of a value passed from one thread to another without locks.
+// The writer fills the back copy while the reader holds on to the front one,
+// and the third is the latest published, which they swap with their own.
+template<class T>
+class TripleBuffer
+{
+public:
+    TripleBuffer(const T &initial) : m_slots(3, initial)
+    {
+        m_back = 0;
+        m_middle = 1;
+        m_front = 2;
+    }
+
+    // writer side, fill back() then publish it
+    T & back()
+    {
+        return m_slots[m_back];
+    }
+
+    void publish()
+    {
+        m_back = atomicExchange(&m_middle, m_back | Fresh) & Index;
+    }
+
+    // reader side, take the latest published copy if it was not taken yet
+    bool update()
+    {
+        if(!(m_middle & Fresh))
+            return false;
+        m_front = atomicExchange(&m_middle, m_front) & Index;
+        return true;
+    }
+
+    const T & front() const
+    {
+        return m_slots[m_front];
+    }
+
+private:
+    enum
+    {
+        Index = 3,
+        Fresh = 4                   // set on the middle index until the reader takes it
+    };
+
+    std::vector<T> m_slots;
+    int m_back;
+    int m_front;
+    volatile int m_middle;
+};
+
+#endif
@@ -27,6 +27,11 @@
 #include <inttypes.h>
 #include <vector>
 
+// SSE code paths are used when the compiler targets it, e.g. not on ARM
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define HAVE_SSE
+#endif
+
 bool fequal(double a, double b);
 
 class vec2
@@ -70,6 +75,9 @@ public:
 vec3 operator+(const vec3 &a, const vec3 &b);
 vec3 operator-(const vec3 &a, const vec3 &b);
 
+// grow the first sphere so that it contains the second one
+void mergeSpheres(vec3 &center, float &radius, const vec3 &center2, float radius2);
+
 class vec4
 {
 public:
@@ -103,6 +111,8 @@ public:
 
     void clear();
     void setIdentity();
+    // zero matrix when it can not be inverted
+    matrix4 inverse() const;
 
     void dump() const;
 
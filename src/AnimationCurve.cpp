@@ -0,0 +1,106 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <algorithm>
+#include "AnimationCurve.h"
+
+using namespace std;
+
+AnimationCurve::AnimationCurve()
+{
+    m_period = 1.0;
+    m_frequency = 1.0;
+    m_tolerance = 0.0;
+    m_error = 0.0;
+    m_samples.resize(2, 0.0);
+}
+
+void AnimationCurve::bake(Function f, double period, int samples, float tolerance, int maxSamples)
+{
+    m_period = period;
+    m_frequency = 1.0 / period;
+    m_tolerance = tolerance;
+    for(int n = max(samples, 1); ; n *= 2)
+    {
+        m_samples.resize(n + 1);
+        for(int i = 0; i < n; i++)
+            m_samples[i] = f(period * i / n);
+        m_samples[n] = m_samples[0];
+        m_error = sampleError(f);
+        if((m_error <= tolerance) || (n * 2 > maxSamples))
+            break;
+    }
+}
+
+void AnimationCurve::bake(const Source &source)
+{
+    bake(source.function, source.period, source.samples, source.tolerance);
+}
+
+float AnimationCurve::value(double t) const
+{
+    int n = size();
+    double x = t * m_frequency;
+    x = (x - floor(x)) * n;
+    int i = min((int)x, n - 1);
+    float a = m_samples[i], b = m_samples[i + 1];
+    return a + (b - a) * (float)(x - i);
+}
+
+int AnimationCurve::size() const
+{
+    return m_samples.size() - 1;
+}
+
+float AnimationCurve::error() const
+{
+    return m_error;
+}
+
+// interpolation is the furthest from a smooth function between samples
+float AnimationCurve::sampleError(Function f) const
+{
+    int n = size();
+    float error = 0.0;
+    for(int i = 0; i < n; i++)
+    {
+        for(int j = 1; j < 4; j++)
+        {
+            double t = m_period * (i + j * 0.25) / n;
+            error = max(error, (float)fabs(value(t) - f(t)));
+        }
+    }
+    return error;
+}
+
+float AnimationCurve::measure(Function f, int n) const
+{
+    float error = 0.0;
+    for(int i = 0; i < n; i++)
+    {
+        double t = m_period * (i + 0.5) / n;
+        error = max(error, (float)fabs(value(t) - f(t)));
+    }
+    return error;
+}
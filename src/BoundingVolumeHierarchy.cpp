@@ -0,0 +1,311 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <algorithm>
+#include "BoundingVolumeHierarchy.h"
+
+using namespace std;
+
+// deep enough for any tree built by splitting at the median
+static const int MaxDepth = 64;
+
+// sorts instances along one axis
+class CenterLess
+{
+public:
+    CenterLess(const vector<BoundingVolumeHierarchy::Bounds> &instances, int axis)
+        : m_instances(instances), m_axis(axis)
+    {
+    }
+
+    bool operator()(int a, int b) const
+    {
+        const vec3 &ca = m_instances[a].center;
+        const vec3 &cb = m_instances[b].center;
+        switch(m_axis)
+        {
+        default:
+        case 0:
+            return ca.x < cb.x;
+        case 1:
+            return ca.y < cb.y;
+        case 2:
+            return ca.z < cb.z;
+        }
+    }
+
+private:
+    const vector<BoundingVolumeHierarchy::Bounds> &m_instances;
+    int m_axis;
+};
+
+static bool visibleLess(const BoundingVolumeHierarchy::Visible &a,
+                        const BoundingVolumeHierarchy::Visible &b)
+{
+    return a.index < b.index;
+}
+
+static bool hitLess(const BoundingVolumeHierarchy::RayHit &a,
+                    const BoundingVolumeHierarchy::RayHit &b)
+{
+    return a.distance < b.distance;
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+    m_count = 0;
+    m_builtLooseness = 0.0;
+    m_rebuilds = 0;
+}
+
+int BoundingVolumeHierarchy::nodeCount() const
+{
+    return m_nodes.size();
+}
+
+int BoundingVolumeHierarchy::rebuildCount() const
+{
+    return m_rebuilds;
+}
+
+void BoundingVolumeHierarchy::update(const vector<Bounds> &instances)
+{
+    if(((int)instances.size() != m_count) || !refit(instances))
+        build(instances);
+    else if(looseness() > (m_builtLooseness * 1.5))
+        build(instances);
+}
+
+void BoundingVolumeHierarchy::build(const vector<Bounds> &instances)
+{
+    m_nodes.clear();
+    m_unbounded.clear();
+    vector<int> order;
+    for(size_t i = 0; i < instances.size(); i++)
+    {
+        if(instances[i].radius < 0.0)
+            m_unbounded.push_back(i);
+        else
+            order.push_back(i);
+    }
+    m_count = instances.size();
+    if(!order.empty())
+    {
+        m_nodes.reserve(order.size() * 2 - 1);
+        buildNode(order, 0, order.size(), instances);
+        refit(instances);
+    }
+    m_builtLooseness = looseness();
+    m_rebuilds++;
+}
+
+int BoundingVolumeHierarchy::buildNode(vector<int> &order, int first, int last,
+                                       const vector<Bounds> &instances)
+{
+    int index = m_nodes.size();
+    Node n;
+    n.radius = -1.0;
+    n.weight = 0;
+    n.right = -1;
+    n.instance = -1;
+    m_nodes.push_back(n);
+    if((last - first) == 1)
+    {
+        m_nodes[index].instance = order[first];
+        return index;
+    }
+
+    // split at the median, along the axis where the instances are the most spread
+    vec3 low = instances[order[first]].center, high = low;
+    for(int i = first + 1; i < last; i++)
+    {
+        const vec3 &c = instances[order[i]].center;
+        low = vec3(min(low.x, c.x), min(low.y, c.y), min(low.z, c.z));
+        high = vec3(max(high.x, c.x), max(high.y, c.y), max(high.z, c.z));
+    }
+    int axis = 0;
+    for(int i = 1; i < 3; i++)
+    {
+        if((component(high, i) - component(low, i)) > (component(high, axis) - component(low, axis)))
+            axis = i;
+    }
+    int middle = (first + last) / 2;
+    nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                CenterLess(instances, axis));
+    buildNode(order, first, middle, instances);
+    int right = buildNode(order, middle, last, instances);
+    m_nodes[index].right = right;
+    return index;
+}
+
+bool BoundingVolumeHierarchy::refit(const vector<Bounds> &instances)
+{
+    // children come after their parent, so going backwards visits them first
+    for(int i = (int)m_nodes.size() - 1; i >= 0; i--)
+    {
+        Node &n = m_nodes[i];
+        if(n.instance >= 0)
+        {
+            const Bounds &b = instances[n.instance];
+            if(b.radius < 0.0)
+                return false;
+            n.center = b.center;
+            n.radius = b.radius;
+            n.weight = b.weight;
+        }
+        else
+        {
+            const Node &left = m_nodes[i + 1];
+            const Node &right = m_nodes[n.right];
+            n.center = left.center;
+            n.radius = left.radius;
+            n.weight = left.weight + right.weight;
+            mergeSpheres(n.center, n.radius, right.center, right.radius);
+        }
+    }
+    for(size_t i = 0; i < m_unbounded.size(); i++)
+    {
+        if(instances[m_unbounded[i]].radius >= 0.0)
+            return false;
+    }
+    return true;
+}
+
+float BoundingVolumeHierarchy::looseness() const
+{
+    // how much larger the inner spheres are than the instances, which does
+    // not change when the whole scene is moved or scaled
+    float inner = 0.0, leaves = 0.0;
+    for(size_t i = 0; i < m_nodes.size(); i++)
+    {
+        if(m_nodes[i].instance >= 0)
+            leaves += m_nodes[i].radius;
+        else
+            inner += m_nodes[i].radius;
+    }
+    return (leaves > 0.0) ? (inner / leaves) : 0.0;
+}
+
+float BoundingVolumeHierarchy::component(const vec3 &v, int axis)
+{
+    return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+}
+
+void BoundingVolumeHierarchy::cull(const Frustum &frustum, const OcclusionCuller *occlusion,
+                                   vector<Visible> &visible, int &outside, int &occluded) const
+{
+    visible.clear();
+    for(size_t i = 0; i < m_unbounded.size(); i++)
+    {
+        Visible v;
+        v.index = m_unbounded[i];
+        v.inside = false;
+        visible.push_back(v);
+    }
+    if(m_nodes.empty())
+        return;
+
+    // the subtrees of nodes which are inside the frustum are not tested against it
+    int stack[MaxDepth];
+    bool stackInside[MaxDepth];
+    int top = 0;
+    stack[top] = 0;
+    stackInside[top++] = false;
+    while(top > 0)
+    {
+        top--;
+        int i = stack[top];
+        bool inside = stackInside[top];
+        while(i >= 0)
+        {
+            const Node &n = m_nodes[i];
+            if(!inside)
+            {
+                Frustum::Result r = frustum.test(n.center, n.radius);
+                if(r == Frustum::Outside)
+                {
+                    outside += n.weight;
+                    break;
+                }
+                inside = (r == Frustum::Inside);
+            }
+            if(occlusion && occlusion->isOccluded(n.center, n.radius))
+            {
+                occluded += n.weight;
+                break;
+            }
+            if(n.instance >= 0)
+            {
+                Visible v;
+                v.index = n.instance;
+                v.inside = inside;
+                visible.push_back(v);
+                break;
+            }
+            stack[top] = n.right;
+            stackInside[top++] = inside;
+            i++;
+        }
+    }
+    sort(visible.begin(), visible.end(), visibleLess);
+}
+
+void BoundingVolumeHierarchy::intersect(const vec3 &origin, const vec3 &direction,
+                                        vector<RayHit> &hits) const
+{
+    hits.clear();
+    float dd = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+    if(m_nodes.empty() || (dd <= 0.0))
+        return;
+
+    int stack[MaxDepth];
+    int top = 0;
+    stack[top++] = 0;
+    while(top > 0)
+    {
+        int i = stack[--top];
+        while(i >= 0)
+        {
+            // solve |origin + t * direction - center| = radius
+            const Node &n = m_nodes[i];
+            vec3 oc = n.center - origin;
+            float b = oc.x * direction.x + oc.y * direction.y + oc.z * direction.z;
+            float c = oc.x * oc.x + oc.y * oc.y + oc.z * oc.z - n.radius * n.radius;
+            float disc = b * b - dd * c;
+            if((disc < 0.0) || ((b + sqrt(disc)) < 0.0))
+                break;
+            if(n.instance >= 0)
+            {
+                RayHit h;
+                h.index = n.instance;
+                h.distance = max((b - (float)sqrt(disc)) / dd, 0.0f);
+                hits.push_back(h);
+                break;
+            }
+            stack[top++] = n.right;
+            i++;
+        }
+    }
+    sort(hits.begin(), hits.end(), hitLess);
+}
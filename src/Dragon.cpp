@@ -26,21 +26,22 @@
 #include "RenderState.h"
 #include "Scene.h"
 
-Dragon::Dragon(Kind kind, RenderState *state) : StateObject(state)
-{
-    m_kind = kind;
-    theta_jaw = 0.0;
-    theta_head_z = 0.0;
-    theta_head_y = 0.0;
-    theta_neck = 0.0;
-    theta_wing = 0.0;
-    theta_wing_joint = 0.0;
-    theta_front_legs = 0.0;
-    theta_back_legs = 0.0;
-    theta_paw = 0.0;
-    theta_tail = 0.0;
-    m_alpha = 0.0;
-    m_beta = 0.0;
+static const char *meshNames[] =
+{
+    "dragon_head",
+    "letter_a",
+    "letter_s",
+    "joint",
+    "dragon_chest",
+    "wing_membrane",
+    "dragon_tail_end"
+};
+
+Dragon::Dragon(Kind kind, RenderState *state, DragonPoses *poses) : StateObject(state)
+{
+    m_ownsPoses = (poses == 0);
+    m_poses = m_ownsPoses ? new DragonPoses(1) : poses;
+    m_pose = m_poses->add(kind);
     m_tongueMaterial = Material(vec4(0.1, 0.0, 0.0, 1.0),
         vec4(0.6, 0.0, 0.0, 1.0), vec4(1.0, 1.0, 1.0, 1.0), 50.0);
     m_scalesMaterial = Material(vec4(0.2, 0.2, 0.2, 1.0),
@@ -52,29 +53,39 @@ Dragon::Dragon(Kind kind, RenderState *state) : StateObject(state)
     setDetailLevel(4);
 }
 
-float Dragon::frontLegsAngle() const
+const float & Dragon::pose(int parameter) const
+{
+    return m_poses->value(parameter, m_pose);
+}
+
+const float & Dragon::frontLegsAngle() const
+{
+    return pose(DragonPoses::FrontLegs);
+}
+
+const float & Dragon::alpha() const
 {
-    return theta_front_legs;
+    return pose(DragonPoses::Alpha);
 }
 
-float Dragon::alpha() const
+const float & Dragon::beta() const
 {
-    return m_alpha;
+    return pose(DragonPoses::Beta);
 }
 
-float Dragon::beta() const
+const float & Dragon::wingBeat() const
 {
-    return m_beta;
+    return pose(DragonPoses::WingBeat);
 }
 
 void Dragon::setAlpha(float v)
 {
-    m_alpha = v;
+    m_poses->value(DragonPoses::Alpha, m_pose) = v;
 }
 
 void Dragon::setBeta(float v)
 {
-    m_beta = v;
+    m_poses->value(DragonPoses::Beta, m_pose) = v;
 }
 
 void Dragon::setDetailLevel(int level)
@@ -125,6 +136,37 @@ Material & Dragon::membraneMaterial()
     return m_membraneMaterial;
 }
 
+Dragon::~Dragon()
+{
+    releaseMeshes();
+    if(m_ownsPoses)
+        delete m_poses;
+}
+
+void Dragon::acquireMeshes()
+{
+    releaseMeshes();
+    for(int i = 0; i < MeshCount; i++)
+        m_meshes[i] = m_state->acquireMesh(meshNames[i]);
+}
+
+void Dragon::releaseMeshes()
+{
+    for(int i = 0; i < MeshCount; i++)
+    {
+        m_state->releaseMesh(m_meshes[i]);
+        m_meshes[i] = MeshHandle();
+    }
+}
+
+void Dragon::registerMaterials()
+{
+    m_state->registerMaterial(m_tongueMaterial);
+    m_state->registerMaterial(m_scalesMaterial);
+    m_state->registerMaterial(m_wingMaterial);
+    m_state->registerMaterial(m_membraneMaterial);
+}
+
 void Dragon::draw()
 {
     pushMaterial(m_scalesMaterial);
@@ -132,7 +174,7 @@ void Dragon::draw()
         scale(1.0/3.0, 1.0/3.0, 1.0/3.0);
         pushMatrix();
             translate(1.0, 0.0, 0.0);
-            rotate(theta_neck, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::Neck)), 0.0, 0.0, 1.0);
             scale(2.0, 2.0, 2.0);
             drawUpper();
         popMatrix();
@@ -155,11 +197,12 @@ void Dragon::draw()
 
 void Dragon::drawUpper()
 {
+    pushName(Scene::DRAGON_UPPER);
     pushMatrix();
         pushMatrix();
             translate(0.4, -0.04, 0.0);
-            rotate(theta_head_y, 0.0, 1.0, 0.0);
-            rotate(theta_head_z, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::HeadY)), 0.0, 1.0, 0.0);
+            rotate(bind(pose(DragonPoses::HeadZ)), 0.0, 0.0, 1.0);
             scale(0.6, 0.6, 0.6);
             drawHead();
         popMatrix();
@@ -168,44 +211,49 @@ void Dragon::drawUpper()
             drawJoint();
         popMatrix();
     popMatrix();
+    popName();
 }
 
 void Dragon::drawHead()
 {
+    pushName(Scene::DRAGON_HEAD);
     pushMatrix();
-        drawMesh("dragon_head");
+        drawMesh(m_meshes[HeadMesh]);
         // tongue
         pushMatrix();
             pushMaterial(m_tongueMaterial);
             translate(0.1, 0.0, 0.0);
-            rotate(-theta_jaw, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::Jaw), -1.0), 0.0, 0.0, 1.0);
             scale(0.9, 0.9, 0.9);
             drawTongue();
             popMaterial();
         popMatrix();
         // jaw
         pushMatrix();
-            rotate(-theta_jaw, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::Jaw), -1.0), 0.0, 0.0, 1.0);
             rotate(90.0, 1.0, 0.0, 0.0);
             scale(1.0, 0.75, 0.5);
-            drawMesh("letter_a");
+            drawMesh(m_meshes[LetterAMesh]);
         popMatrix();
     popMatrix();
+    popName();
 }
 
 void Dragon::drawTongue()
 {
+    pushName(Scene::DRAGON_TONGUE);
     pushMatrix();
         translate(0.47, 0.0, 0.0);
         scale(1.1, 0.275, 1.1);
         rotate(180.0, 1.0, 0.0, 0.0);
-        drawMesh("letter_s");
+        drawMesh(m_meshes[LetterSMesh]);
     popMatrix();
+    popName();
 }
 
 void Dragon::drawJoint()
 {
-    drawMesh("joint");
+    drawMesh(m_meshes[JointMesh]);
 }
 
 void Dragon::drawBody()
@@ -226,7 +274,7 @@ void Dragon::drawBody()
         // left wing
         pushMaterial(m_wingMaterial);
         pushMatrix();
-            rotate(theta_wing, 1.0, 0.0, 0.0);
+            rotate(bind(pose(DragonPoses::Wing)), 1.0, 0.0, 0.0);
             rotate(90.0, 0.0, 1.0, 0.0);
             scale(3.0, 3.0, 3.0);
             drawWing();
@@ -235,7 +283,7 @@ void Dragon::drawBody()
         // right wing
         pushMatrix();
             rotate(180.0, 0.0, 1.0, 0.0);
-            rotate(theta_wing, 1.0, 0.0, 0.0);
+            rotate(bind(pose(DragonPoses::Wing)), 1.0, 0.0, 0.0);
             rotate(90.0, 0.0, 1.0, 0.0);
             scale(3.0, 3.0, 3.0);
             drawWing();
@@ -246,7 +294,9 @@ void Dragon::drawBody()
 
 void Dragon::drawChest()
 {
-    drawMesh("dragon_chest");
+    pushName(Scene::DRAGON_CHEST);
+    drawMesh(m_meshes[ChestMesh]);
+    popName();
 }
 
 void Dragon::drawWing()
@@ -257,7 +307,7 @@ void Dragon::drawWing()
         drawWingPart();
         pushMatrix();
             translate(1.0, 0.0, 0.0);
-            rotate(-theta_wing_joint, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::WingJoint), -1.0), 0.0, 0.0, 1.0);
             drawWingOuter();
         popMatrix();
     popMatrix();
@@ -265,10 +315,11 @@ void Dragon::drawWing()
 
 void Dragon::drawWingPart()
 {
+    pushName(Scene::DRAGON_WING_PART);
     pushMatrix();
         rotate(90.0, 1.0, 0.0, 0.0);
         scale(1.0, 2.6, 0.20);
-        drawMesh("letter_a");
+        drawMesh(m_meshes[LetterAMesh]);
     popMatrix();
     pushMaterial(m_membraneMaterial);
     pushMatrix();
@@ -293,11 +344,14 @@ void Dragon::drawWingPart()
         drawWingMembrane();
     popMatrix();
     popMaterial();
+    popName();
 }
 
 void Dragon::drawWingMembrane()
 {
-    drawMesh("wing_membrane");
+    pushName(Scene::DRAGON_WING_MEMBRANE);
+    drawMesh(m_meshes[MembraneMesh]);
+    popName();
 }
 
 void Dragon::drawWingOuter()
@@ -316,7 +370,7 @@ void Dragon::drawPaws()
         // front left paw
         pushMatrix();
             translate(0.5, 0.0, -0.15);
-            rotate(-theta_front_legs, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::FrontLegs), -1.0), 0.0, 0.0, 1.0);
             rotate(10.0, 0.0, 1.0, 0.0);
             scale(0.8, 0.8, 0.8);
             drawPaw();
@@ -325,7 +379,7 @@ void Dragon::drawPaws()
         // front right paw
         pushMatrix();
             translate(0.5, 0.0, 0.15);
-            rotate(-theta_front_legs, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::FrontLegs), -1.0), 0.0, 0.0, 1.0);
             rotate(-10.0, 0.0, 1.0, 0.0);
             scale(0.8, 0.8, 0.8);
             drawPaw();
@@ -334,7 +388,7 @@ void Dragon::drawPaws()
         // hind left paw
         pushMatrix();
             translate(-0.5, 0.0, -0.15);
-            rotate(-theta_back_legs, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::BackLegs), -1.0), 0.0, 0.0, 1.0);
             rotate(10.0, 0.0, 1.0, 0.0);
             scale(1.2, 1.2, 1.2);
             drawPaw();
@@ -343,7 +397,7 @@ void Dragon::drawPaws()
         // hind right paw
         pushMatrix();
             translate(-0.5, 0.0, 0.15);
-            rotate(-theta_back_legs, 0.0, 0.0, 1.0);
+            rotate(bind(pose(DragonPoses::BackLegs), -1.0), 0.0, 0.0, 1.0);
             rotate(-10.0, 0.0, 1.0, 0.0);
             scale(1.2, 1.2, 1.2);
             drawPaw();
@@ -353,39 +407,30 @@ void Dragon::drawPaws()
 
 void Dragon::drawPaw()
 {
+    pushName(Scene::DRAGON_PAW);
     pushMatrix();
         translate(0.5, 0.0, 0.0);
-        rotate(theta_paw, 0.0, 0.0, 1.0);
+        rotate(bind(pose(DragonPoses::Paw)), 0.0, 0.0, 1.0);
         rotate(90.0, 1.0, 0.0, 0.0);
         scale(0.5, 0.5, 0.5);
-        drawMesh("letter_a");
+        drawMesh(m_meshes[LetterAMesh]);
     popMatrix();
     pushMatrix();
         scale(0.6, 0.5, 0.5);
         drawJoint();
     popMatrix();
+    popName();
 }
 
 void Dragon::drawTail()
 {
+    pushName(Scene::DRAGON_TAIL);
     uint32_t n = 10;
-    float k = theta_tail / 20.0;
     static float sizes[10] =
     {
         // make the tail smaller and smaller as we get near the end
         1.0, 0.80, 0.75, 0.75, 0.77, 0.86, 0.9, 0.89, 0.88, 0.86
     };
-    float angles[10] =
-    {
-        // rotate more and more each joint to make the tail curl
-        -theta_tail, 0.0, 0.0, 45.0  * k, 45.0  * k, 60.0 * k, 45.0 * k, 60.0 * k, 120.0 * k, 60.0 * k
-    };
-    float mod[10] =
-    {
-        // slow down some joints by a factor inversely proportional to their size
-        // 1.0, 0.80, 0.6, 0.45, 0.35, 0.30, 0.27, 0.24, 0.21, 0.18
-        1.0, 1.0, 1.0, 0.6 * 0.45, 0.6 * 0.35, 0.6 * 0.30, 0.6 * 0.27, 0.6 * 0.24, 1.0, 1.0
-    };
     pushMatrix();
         scale(0.5, 0.5, 0.5);
         // keep the transformation matrix for each joint,
@@ -397,7 +442,7 @@ void Dragon::drawTail()
             {
                 float f = sizes[i];
                 translate(0.80, 0.0, 0.0);
-                rotate(angles[i] * mod[i], 0.0, 0.0, 1.0);
+                rotate(bind(pose(DragonPoses::TailJoint + i)), 0.0, 0.0, 1.0);
                 scale(f, f, f);
                 drawJoint();
             }
@@ -407,44 +452,12 @@ void Dragon::drawTail()
             drawTailEnd();
         popMatrix();
     popMatrix();
+    popName();
 }
 
 void Dragon::drawTailEnd()
 {
-    drawMesh("dragon_tail_end");
-}
-
-void Dragon::animate(float t)
-{
-    theta_jaw = 10.0 * Scene::spaced_cos(t, 5.0, 2.0) + 10.0;
-    theta_head_y = 45.0 * Scene::spaced_cos(t, 5.0, 2.0);
-    theta_neck = 5.0 * cos(t * 3.0);
-    theta_wing = 45.0 * cos(t * 3.5);
-    theta_wing_joint = 60.0 - 30.0 * fabs(cos(t * 3.5) * cos(t));
-    theta_front_legs = 10.0 * cos(t * 3.0) + 40.0 + 45.0;
-    theta_back_legs = 10.0 * cos(t * 3.0) + 80.0 + 45.0;
-    theta_tail = 15.0 * cos(pow(t * 0.3, 2.0)) * cos(6.0 * t * 0.3);
-    switch(m_kind)
-    {
-    case Floating:
-        theta_head_z = -45.0;
-        theta_paw = 60.0;
-        break;
-    case Flying:
-        theta_head_z = -30.0;
-        theta_neck = 30.0;
-        theta_paw = 60.0;
-        break;
-    case Jumping:
-        theta_wing = 0.0;
-        theta_wing_joint = 20.0;
-        theta_neck = 30.0;
-        theta_paw = 60.0;
-        theta_neck = 30.0;
-        theta_paw = 60.0;
-        // this one is definitely having the time of its life
-        theta_head_z = 60.0 * Scene::spaced_cos(t, 1.0, 2.0) - 30.0;
-        theta_jaw = 10.0 * Scene::spaced_cos(t, 1.0, 2.0) + 10.0;
-        break;
-    }
+    pushName(Scene::DRAGON_TAIL_END);
+    drawMesh(m_meshes[TailEndMesh]);
+    popName();
 }
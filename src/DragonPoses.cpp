@@ -0,0 +1,329 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <algorithm>
+#include "DragonPoses.h"
+#include "AnimationCurve.h"
+#include "Dragon.h"
+#include "JobSystem.h"
+#include "Scene.h"
+#include "Vertex.h"
+#ifdef HAVE_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+// how much each joint of the tail follows the tail angle, the smaller joints
+// being slowed down by a factor inversely proportional to their size
+static const float tailFactors[10] =
+{
+    -1.0, 0.0, 0.0,
+    45.0 / 20.0 * 0.6 * 0.45, 45.0 / 20.0 * 0.6 * 0.35, 60.0 / 20.0 * 0.6 * 0.30,
+    45.0 / 20.0 * 0.6 * 0.27, 60.0 / 20.0 * 0.6 * 0.24, 120.0 / 20.0, 60.0 / 20.0
+};
+
+DragonPoses::DragonPoses(int capacity)
+{
+    m_count = 0;
+    m_time = 0.0;
+    m_stride = (max(capacity, 1) + 3) & ~3;
+    m_values.resize(ParameterCount * m_stride, 0.0);
+    m_kinds.resize(m_stride, Dragon::Floating);
+    m_timeOffsets.resize(m_stride, 0.0);
+    m_channels.resize(ChannelCount * m_stride, 0.0);
+    bakeCurves();
+}
+
+int DragonPoses::count() const
+{
+    return m_count;
+}
+
+int DragonPoses::capacity() const
+{
+    return m_stride;
+}
+
+int DragonPoses::add(int kind)
+{
+    if(m_count >= m_stride)
+        return -1;
+    m_kinds[m_count] = kind;
+    return m_count++;
+}
+
+void DragonPoses::setTimeOffset(int index, float offset)
+{
+    m_timeOffsets[index] = offset;
+}
+
+float & DragonPoses::value(int parameter, int index)
+{
+    return m_values[parameter * m_stride + index];
+}
+
+const float & DragonPoses::value(int parameter, int index) const
+{
+    return m_values[parameter * m_stride + index];
+}
+
+// the curves followed by dragons, before they are baked
+static double beatCurve(double t)
+{
+    return cos(t * 3.5);
+}
+
+static double legsCurve(double t)
+{
+    return cos(t * 3.0);
+}
+
+// the wing joint follows its absolute value, taken after reading the table so
+// that its corners are not smoothed out
+static double wingJointCurve(double t)
+{
+    return cos(t * 3.5) * cos(t);
+}
+
+static double slowCurve(double t)
+{
+    return Scene::spaced_cos(t, 5.0, 2.0);
+}
+
+static double fastCurve(double t)
+{
+    return Scene::spaced_cos(t, 1.0, 2.0);
+}
+
+static double swingCurve(double t)
+{
+    return cos(t * 1.8);
+}
+
+// the tail follows cos(t^2), which never repeats, so only the cosine is baked
+static double cosineCurve(double t)
+{
+    return cos(t);
+}
+
+enum
+{
+    BeatCurve,
+    LegsCurve,
+    WingJointCurve,
+    SlowCurve,
+    FastCurve,
+    SwingCurve,
+    CosineCurve,
+    CurveCount
+};
+
+// angles are made from values between -1 and 1, so that the largest one, 45
+// times the curve, is within 0.0005 degree of the function it was baked from
+static const float curveTolerance = 1e-5;
+
+// the corners of the spaced cosines, at 0 and w, fall on samples
+static const AnimationCurve::Source dragonCurves[CurveCount] =
+{
+    {"beat", beatCurve, 2.0 * M_PI / 3.5, 16, curveTolerance},
+    {"legs", legsCurve, 2.0 * M_PI / 3.0, 16, curveTolerance},
+    {"wing joint", wingJointCurve, 4.0 * M_PI, 16, curveTolerance},
+    {"slow", slowCurve, 7.0, 7 * 4, curveTolerance},
+    {"fast", fastCurve, 3.0, 3 * 4, curveTolerance},
+    {"swing", swingCurve, 2.0 * M_PI / 1.8, 16, curveTolerance},
+    {"cosine", cosineCurve, 2.0 * M_PI, 16, curveTolerance}
+};
+
+static AnimationCurve curves[CurveCount];
+static bool curvesBaked = false;
+
+void DragonPoses::bakeCurves()
+{
+    if(curvesBaked)
+        return;
+    for(int i = 0; i < CurveCount; i++)
+        curves[i].bake(dragonCurves[i]);
+    curvesBaked = true;
+}
+
+const AnimationCurve::Source * DragonPoses::curveSources(int &count)
+{
+    count = CurveCount;
+    return dragonCurves;
+}
+
+// dragons animated by a job, a multiple of four
+static const int BlockSize = 64;
+
+void DragonPoses::animate(float t)
+{
+    m_time = t;
+    int blocks = (m_count + BlockSize - 1) / BlockSize;
+    JobSystem::shared()->parallelFor(animateBlockTask, this, blocks, 1);
+}
+
+void DragonPoses::animateBlockTask(void *arg, int index)
+{
+    ((DragonPoses *)arg)->animateBlock(index);
+}
+
+void DragonPoses::animateBlock(int block)
+{
+    int first = block * BlockSize;
+    int last = min(first + BlockSize, m_count);
+    for(int i = first; i < last; i++)
+        sampleChannels(i, (double)m_time + m_timeOffsets[i]);
+#ifdef HAVE_SSE
+    for(int i = first; i < last; i += 4)
+        combineBatch(i);
+#else
+    for(int i = first; i < last; i++)
+        combineScalar(i);
+#endif
+}
+
+void DragonPoses::interpolate(const DragonPoses &from, const DragonPoses &to, float f)
+{
+    int count = min(m_count, min(from.m_count, to.m_count));
+    for(int p = 0; p < ParameterCount; p++)
+    {
+        const float *a = &from.m_values[p * from.m_stride];
+        const float *b = &to.m_values[p * to.m_stride];
+        float *v = &m_values[p * m_stride];
+        for(int i = 0; i < count; i++)
+            v[i] = mix(a[i], b[i], f);
+    }
+}
+
+// no parameter moves by half a turn between two steps of a simulation, so
+// this only happens when an angle wraps around
+float DragonPoses::mix(float a, float b, float f)
+{
+    float d = b - a;
+    if(fabs(d) > 180.0)
+        d -= 360.0 * floor(d / 360.0 + 0.5);
+    return a + d * f;
+}
+
+void DragonPoses::sampleChannels(int index, double t)
+{
+    double u = t * 0.3;
+    m_channels[BeatChannel * m_stride + index] = curves[BeatCurve].value(t);
+    m_channels[LegsChannel * m_stride + index] = curves[LegsCurve].value(t);
+    m_channels[WingJointChannel * m_stride + index] = curves[WingJointCurve].value(t);
+    m_channels[SlowChannel * m_stride + index] = curves[SlowCurve].value(t);
+    m_channels[FastChannel * m_stride + index] = curves[FastCurve].value(t);
+    m_channels[TailChannel * m_stride + index] = 15.0 * curves[CosineCurve].value(u * u) * curves[SwingCurve].value(t);
+}
+
+void DragonPoses::combineScalar(int index)
+{
+    float beat = m_channels[BeatChannel * m_stride + index];
+    float legs = m_channels[LegsChannel * m_stride + index];
+    float slow = m_channels[SlowChannel * m_stride + index];
+    float fast = m_channels[FastChannel * m_stride + index];
+    float tail = m_channels[TailChannel * m_stride + index];
+    float jaw = 10.0 * slow + 10.0;
+    float headZ = -45.0;
+    float neck = 5.0 * legs;
+    float wing = 45.0 * beat;
+    float wingJoint = 60.0 - 30.0 * fabs(m_channels[WingJointChannel * m_stride + index]);
+    switch((int)m_kinds[index])
+    {
+    case Dragon::Floating:
+        break;
+    case Dragon::Flying:
+        headZ = -30.0;
+        neck = 30.0;
+        break;
+    case Dragon::Jumping:
+        wing = 0.0;
+        wingJoint = 20.0;
+        neck = 30.0;
+        // this one is definitely having the time of its life
+        headZ = 60.0 * fast - 30.0;
+        jaw = 10.0 * fast + 10.0;
+        break;
+    }
+    value(Jaw, index) = jaw;
+    value(HeadZ, index) = headZ;
+    value(HeadY, index) = 45.0 * slow;
+    value(Neck, index) = neck;
+    value(Wing, index) = wing;
+    value(WingJoint, index) = wingJoint;
+    value(FrontLegs, index) = 10.0 * legs + 40.0 + 45.0;
+    value(BackLegs, index) = 10.0 * legs + 80.0 + 45.0;
+    value(Paw, index) = 60.0;
+    value(Tail, index) = tail;
+    for(int i = 0; i < 10; i++)
+        value(TailJoint + i, index) = tail * tailFactors[i];
+    value(WingBeat, index) = beat;
+}
+
+#ifdef HAVE_SSE
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+void DragonPoses::combineBatch(int first)
+{
+    __m128 kind = _mm_loadu_ps(&m_kinds[first]);
+    __m128 flying = _mm_cmpeq_ps(kind, _mm_set1_ps(Dragon::Flying));
+    __m128 jumping = _mm_cmpeq_ps(kind, _mm_set1_ps(Dragon::Jumping));
+    __m128 ten = _mm_set1_ps(10.0f);
+
+    __m128 beat = _mm_loadu_ps(&m_channels[BeatChannel * m_stride + first]);
+    __m128 c3 = _mm_loadu_ps(&m_channels[LegsChannel * m_stride + first]);
+    __m128 joint = _mm_loadu_ps(&m_channels[WingJointChannel * m_stride + first]);
+    __m128 slow = _mm_loadu_ps(&m_channels[SlowChannel * m_stride + first]);
+    __m128 fast = _mm_loadu_ps(&m_channels[FastChannel * m_stride + first]);
+    __m128 tail = _mm_loadu_ps(&m_channels[TailChannel * m_stride + first]);
+
+    __m128 jaw = _mm_add_ps(_mm_mul_ps(ten, select4(jumping, fast, slow)), ten);
+    __m128 headZ = select4(jumping, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(60.0f), fast), _mm_set1_ps(30.0f)),
+                           select4(flying, _mm_set1_ps(-30.0f), _mm_set1_ps(-45.0f)));
+    __m128 neck = select4(_mm_or_ps(flying, jumping), _mm_set1_ps(30.0f), _mm_mul_ps(_mm_set1_ps(5.0f), c3));
+    __m128 wing = _mm_andnot_ps(jumping, _mm_mul_ps(_mm_set1_ps(45.0f), beat));
+    joint = _mm_andnot_ps(_mm_set1_ps(-0.0f), joint);
+    joint = select4(jumping, _mm_set1_ps(20.0f),
+                    _mm_sub_ps(_mm_set1_ps(60.0f), _mm_mul_ps(_mm_set1_ps(30.0f), joint)));
+    __m128 legs = _mm_mul_ps(ten, c3);
+
+    _mm_storeu_ps(&value(Jaw, first), jaw);
+    _mm_storeu_ps(&value(HeadZ, first), headZ);
+    _mm_storeu_ps(&value(HeadY, first), _mm_mul_ps(_mm_set1_ps(45.0f), slow));
+    _mm_storeu_ps(&value(Neck, first), neck);
+    _mm_storeu_ps(&value(Wing, first), wing);
+    _mm_storeu_ps(&value(WingJoint, first), joint);
+    _mm_storeu_ps(&value(FrontLegs, first), _mm_add_ps(legs, _mm_set1_ps(85.0f)));
+    _mm_storeu_ps(&value(BackLegs, first), _mm_add_ps(legs, _mm_set1_ps(125.0f)));
+    _mm_storeu_ps(&value(Paw, first), _mm_set1_ps(60.0f));
+    _mm_storeu_ps(&value(Tail, first), tail);
+    for(int i = 0; i < 10; i++)
+        _mm_storeu_ps(&value(TailJoint + i, first), _mm_mul_ps(tail, _mm_set1_ps(tailFactors[i])));
+    _mm_storeu_ps(&value(WingBeat, first), beat);
+}
+#endif
@@ -0,0 +1,194 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "DrawList.h"
+#include "Mesh.h"
+
+// bits of the sort keys
+#define KEY_PROGRAM_BITS    8
+#define KEY_MATERIAL_BITS   16
+#define KEY_MESH_BITS       16
+#define KEY_DEPTH_BITS      24
+#define KEY_MAX_DEPTH       100.0f
+
+DrawList::DrawList()
+{
+    clear();
+}
+
+void DrawList::clear()
+{
+    m_commands.clear();
+    m_order.clear();
+    m_materials.clear();
+    m_materialIndices.clear();
+    m_lastMaterialID = 0;
+    m_lastMaterial = 0;
+}
+
+uint32_t DrawList::addMaterial(const Material &m)
+{
+    // consecutive draws usually share the same material
+    if((m_materials.size() > 0) && (m.id() == m_lastMaterialID))
+        return m_lastMaterial;
+    map<uint32_t, uint32_t>::iterator it = m_materialIndices.find(m.id());
+    uint32_t index;
+    if(it != m_materialIndices.end())
+    {
+        index = it->second;
+    }
+    else
+    {
+        index = m_materials.size();
+        m_materials.push_back(m);
+        m_materialIndices.insert(pair<uint32_t, uint32_t>(m.id(), index));
+    }
+    m_lastMaterialID = m.id();
+    m_lastMaterial = index;
+    return index;
+}
+
+void DrawList::add(Mesh *mesh, const matrix4 &modelView, uint32_t material, uint32_t program)
+{
+    DrawCommand c;
+    c.mesh = mesh;
+    c.program = program;
+    c.material = material;
+    // the eye looks down the negative Z axis
+    c.depth = -modelView.d[14];
+    c.modelView = modelView;
+    m_commands.push_back(c);
+}
+
+uint32_t DrawList::size() const
+{
+    return m_commands.size();
+}
+
+const DrawCommand & DrawList::at(uint32_t i) const
+{
+    if(m_order.size() == m_commands.size())
+        return m_commands[m_order[i].index];
+    else
+        return m_commands[i];
+}
+
+const Material & DrawList::material(uint32_t index) const
+{
+    return m_materials[index];
+}
+
+uint32_t DrawList::materialCount() const
+{
+    return m_materials.size();
+}
+
+static uint64_t keyBits(uint64_t value, int bits)
+{
+    uint64_t max = ((uint64_t)1 << bits) - 1;
+    return (value < max) ? value : max;
+}
+
+uint64_t DrawList::sortKey(const DrawCommand &c, SortMode mode) const
+{
+    float d = c.depth / KEY_MAX_DEPTH;
+    d = (d < 0.0f) ? 0.0f : ((d > 1.0f) ? 1.0f : d);
+    uint64_t depth = (uint64_t)(d * (float)((1 << KEY_DEPTH_BITS) - 1));
+    uint64_t program = keyBits(c.program, KEY_PROGRAM_BITS);
+    uint64_t material = keyBits(c.material, KEY_MATERIAL_BITS);
+    uint64_t mesh = keyBits(c.mesh ? c.mesh->id() : 0, KEY_MESH_BITS);
+    uint64_t key = 0;
+    switch(mode)
+    {
+    default:
+    case SortByState:
+        key = (program << (KEY_MATERIAL_BITS + KEY_MESH_BITS + KEY_DEPTH_BITS))
+            | (material << (KEY_MESH_BITS + KEY_DEPTH_BITS))
+            | (mesh << KEY_DEPTH_BITS)
+            | depth;
+        break;
+    case SortFrontToBack:
+        key = (depth << (KEY_PROGRAM_BITS + KEY_MATERIAL_BITS + KEY_MESH_BITS))
+            | (program << (KEY_MATERIAL_BITS + KEY_MESH_BITS))
+            | (material << KEY_MESH_BITS)
+            | mesh;
+        break;
+    }
+    return key;
+}
+
+void DrawList::sort(SortMode mode)
+{
+    uint32_t n = m_commands.size();
+    m_order.resize(n);
+    for(uint32_t i = 0; i < n; i++)
+    {
+        m_order[i].key = sortKey(m_commands[i], mode);
+        m_order[i].index = i;
+    }
+    radixSort(m_order, m_temp);
+}
+
+// LSD radix sort on 8-bit digits, stable. Passes where every key has the same
+// digit are skipped, which is common since most of the key bits are unused.
+void DrawList::radixSort(vector<SortItem> &items, vector<SortItem> &temp)
+{
+    uint32_t n = items.size();
+    if(n < 2)
+        return;
+    temp.resize(n);
+    uint32_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for(uint32_t i = 0; i < n; i++)
+    {
+        uint64_t key = items[i].key;
+        for(int pass = 0; pass < 8; pass++)
+            counts[pass][(key >> (pass * 8)) & 0xff]++;
+    }
+    SortItem *src = &items[0];
+    SortItem *dst = &temp[0];
+    for(int pass = 0; pass < 8; pass++)
+    {
+        uint32_t *c = counts[pass];
+        if(c[(src[0].key >> (pass * 8)) & 0xff] == n)
+            continue;
+        uint32_t offsets[256];
+        uint32_t total = 0;
+        for(int b = 0; b < 256; b++)
+        {
+            offsets[b] = total;
+            total += c[b];
+        }
+        for(uint32_t i = 0; i < n; i++)
+        {
+            uint32_t b = (src[i].key >> (pass * 8)) & 0xff;
+            dst[offsets[b]++] = src[i];
+        }
+        SortItem *t = src;
+        src = dst;
+        dst = t;
+    }
+    if(src != &items[0])
+        memcpy(&items[0], src, n * sizeof(SortItem));
+}
@@ -0,0 +1,198 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "DrawRecorder.h"
+
+DrawRecorder::DrawRecorder(const RenderState *target) : RenderState()
+{
+    m_target = target;
+    m_matrix.setIdentity();
+}
+
+void DrawRecorder::begin(const matrix4 &modelView)
+{
+    m_matrix = modelView;
+    m_matrixStack.clear();
+    m_materialStack.clear();
+    m_materials.clear();
+    m_draws.clear();
+}
+
+void DrawRecorder::replay(RenderState *target) const
+{
+    replayDraws(target, 0);
+}
+
+void DrawRecorder::replay(RenderState *target, const matrix4 &view) const
+{
+    replayDraws(target, &view);
+}
+
+void DrawRecorder::replayDraws(RenderState *target, const matrix4 *view) const
+{
+    uint32_t current = NoMaterial;
+    target->pushMatrix();
+    for(size_t i = 0; i < m_draws.size(); i++)
+    {
+        const RecordedDraw &d = m_draws[i];
+        if(d.material != current)
+        {
+            if(current != NoMaterial)
+                target->popMaterial();
+            if(d.material != NoMaterial)
+                target->pushMaterial(m_materials[d.material]);
+            current = d.material;
+        }
+        target->loadIdentity();
+        if(view)
+            target->multiplyMatrix(*view);
+        target->multiplyMatrix(d.modelView);
+        target->drawMesh(d.mesh);
+    }
+    if(current != NoMaterial)
+        target->popMaterial();
+    target->popMatrix();
+}
+
+size_t DrawRecorder::size() const
+{
+    return m_draws.size();
+}
+
+Mesh * DrawRecorder::createMesh() const
+{
+    return 0;
+}
+
+void DrawRecorder::drawMesh(Mesh *m)
+{
+    if(!m)
+        return;
+    RecordedDraw d;
+    d.mesh = m;
+    d.material = m_materialStack.empty() ? (uint32_t)NoMaterial : m_materialStack.back();
+    d.modelView = m_matrix;
+    m_draws.push_back(d);
+}
+
+void DrawRecorder::drawMesh(MeshHandle h)
+{
+    drawMesh(m_target->mesh(h));
+}
+
+void DrawRecorder::drawMesh(const string &name)
+{
+    // the target's meshes are not modified while recording
+    const map<string, Mesh *> &meshes = m_target->meshes();
+    map<string, Mesh *>::const_iterator it = meshes.find(name);
+    if(it != meshes.end())
+        drawMesh(it->second);
+}
+
+void DrawRecorder::freeTextures()
+{
+}
+
+void DrawRecorder::setMatrixMode(MatrixMode newMode)
+{
+    (void)newMode;
+}
+
+void DrawRecorder::loadIdentity()
+{
+    m_matrix.setIdentity();
+}
+
+void DrawRecorder::multiplyMatrix(const matrix4 &m)
+{
+    m_matrix = m_matrix * m;
+}
+
+void DrawRecorder::pushMatrix()
+{
+    m_matrixStack.push_back(m_matrix);
+}
+
+void DrawRecorder::popMatrix()
+{
+    m_matrix = m_matrixStack.back();
+    m_matrixStack.pop_back();
+}
+
+void DrawRecorder::translate(float dx, float dy, float dz)
+{
+    multiplyMatrix(matrix4::translate(dx, dy, dz));
+}
+
+void DrawRecorder::rotate(float angle, float rx, float ry, float rz)
+{
+    multiplyMatrix(matrix4::rotate(angle, rx, ry, rz));
+}
+
+void DrawRecorder::scale(float sx, float sy, float sz)
+{
+    multiplyMatrix(matrix4::scale(sx, sy, sz));
+}
+
+matrix4 DrawRecorder::currentMatrix() const
+{
+    return m_matrix;
+}
+
+void DrawRecorder::beginFrame(int width, int heigth)
+{
+    (void)width;
+    (void)heigth;
+}
+
+void DrawRecorder::setupViewport(int width, int heigth)
+{
+    (void)width;
+    (void)heigth;
+}
+
+void DrawRecorder::endFrame()
+{
+}
+
+void DrawRecorder::pushMaterial(const Material &m)
+{
+    // materials pushed several times are only stored once
+    uint32_t index = m_materials.size();
+    for(uint32_t i = 0; i < m_materials.size(); i++)
+    {
+        if(m_materials[i].id() == m.id())
+        {
+            index = i;
+            break;
+        }
+    }
+    if(index == m_materials.size())
+        m_materials.push_back(m);
+    m_materialStack.push_back(index);
+}
+
+void DrawRecorder::popMaterial()
+{
+    m_materialStack.pop_back();
+}
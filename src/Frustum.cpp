@@ -0,0 +1,101 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include "Frustum.h"
+#ifdef HAVE_SSE
+#include <xmmintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+    matrix4 identity;
+    identity.setIdentity();
+    setProjection(identity);
+}
+
+void Frustum::setProjection(const matrix4 &projection)
+{
+    const float *d = projection.d;
+    for(int i = 0; i < 6; i++)
+    {
+        // add or subtract the first three rows to the last one
+        int row = i / 2;
+        float sign = (i % 2) ? -1.0f : 1.0f;
+        float x = d[3] + sign * d[row];
+        float y = d[7] + sign * d[4 + row];
+        float z = d[11] + sign * d[8 + row];
+        float w = d[15] + sign * d[12 + row];
+        float length = sqrt(x * x + y * y + z * z);
+        if(length > 0.0)
+        {
+            x /= length;
+            y /= length;
+            z /= length;
+            w /= length;
+        }
+        m_x[i] = x;
+        m_y[i] = y;
+        m_z[i] = z;
+        m_w[i] = w;
+    }
+    // padding planes which everything is inside of
+    for(int i = 6; i < PlaneCount; i++)
+    {
+        m_x[i] = m_y[i] = m_z[i] = 0.0;
+        m_w[i] = 1e30f;
+    }
+}
+
+Frustum::Result Frustum::test(const vec3 &center, float radius) const
+{
+    int outside = 0, intersecting = 0;
+#ifdef HAVE_SSE
+    __m128 cx = _mm_set1_ps(center.x);
+    __m128 cy = _mm_set1_ps(center.y);
+    __m128 cz = _mm_set1_ps(center.z);
+    __m128 r = _mm_set1_ps(radius);
+    __m128 nr = _mm_set1_ps(-radius);
+    for(int i = 0; i < PlaneCount; i += 4)
+    {
+        __m128 dist = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m_x + i), cx),
+                                 _mm_mul_ps(_mm_loadu_ps(m_y + i), cy));
+        dist = _mm_add_ps(dist, _mm_mul_ps(_mm_loadu_ps(m_z + i), cz));
+        dist = _mm_add_ps(dist, _mm_loadu_ps(m_w + i));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(dist, nr));
+        intersecting |= _mm_movemask_ps(_mm_cmplt_ps(dist, r));
+    }
+#else
+    for(int i = 0; i < PlaneCount; i++)
+    {
+        float dist = m_x[i] * center.x + m_y[i] * center.y + m_z[i] * center.z + m_w[i];
+        if(dist < -radius)
+            outside = 1;
+        else if(dist < radius)
+            intersecting = 1;
+    }
+#endif
+    if(outside)
+        return Outside;
+    return intersecting ? Intersecting : Inside;
+}
@@ -0,0 +1,432 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#define GL_TRACE_IMPLEMENTATION
+#include "GLTrace.h"
+
+static const uint32_t Unknown = 0xffffffff;
+
+static const char *entryNames[GLTrace::EntryCount] =
+{
+#define GL_TRACE_NAME(ret, name, params, args) #name,
+    GL_TRACE_ENTRIES(GL_TRACE_NAME, GL_TRACE_NAME)
+#undef GL_TRACE_NAME
+};
+
+#ifdef WIN32
+#include <windows.h>
+static double traceTime()
+{
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+}
+#else
+#include <time.h>
+// most calls return in less than a microsecond
+static double traceTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec * 1e-9);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool GLTrace::m_enabled = false;
+bool GLTrace::m_inFrame = false;
+FILE * GLTrace::m_dumpFile = 0;
+uint32_t GLTrace::m_calls[EntryCount];
+uint32_t GLTrace::m_redundant[EntryCount];
+double GLTrace::m_time[EntryCount];
+string GLTrace::m_report;
+
+// What the layer knows about the GL state. Missing entries are unknown.
+struct TraceState
+{
+    uint32_t program;
+    uint32_t vertexArray;
+    uint32_t activeTexture;
+    uint32_t matrixMode;
+    uint32_t readFramebuffer;
+    uint32_t drawFramebuffer;
+    map<uint32_t, uint32_t> buffers;
+    map<uint64_t, vector<uint64_t> > ranges;
+    map<uint64_t, uint32_t> textures;
+    map<uint32_t, bool> caps;
+    map<uint64_t, bool> attributes;
+    map<uint64_t, uint32_t> divisors;
+    map<uint64_t, vector<uint64_t> > pointers;
+    map<uint64_t, vector<uint32_t> > uniforms;
+
+    void invalidate()
+    {
+        program = vertexArray = activeTexture = matrixMode = Unknown;
+        readFramebuffer = drawFramebuffer = Unknown;
+        buffers.clear();
+        ranges.clear();
+        textures.clear();
+        caps.clear();
+        invalidateVertexArrays();
+        uniforms.clear();
+    }
+
+    void invalidateVertexArrays()
+    {
+        attributes.clear();
+        divisors.clear();
+        pointers.clear();
+    }
+};
+
+static TraceState traceState;
+
+static uint64_t key(uint32_t a, uint32_t b)
+{
+    return ((uint64_t)a << 32) | b;
+}
+
+// Set the current value, returning true if it was already set.
+static bool update(uint32_t &current, uint32_t value)
+{
+    if(current == value)
+        return true;
+    current = value;
+    return false;
+}
+
+template<typename K, typename V>
+static bool update(map<K, V> &state, K k, const V &value)
+{
+    typename map<K, V>::iterator it = state.find(k);
+    if((it != state.end()) && (it->second == value))
+        return true;
+    state[k] = value;
+    return false;
+}
+
+bool GLTrace::enabled()
+{
+    return m_enabled;
+}
+
+void GLTrace::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_inFrame = false;
+    traceState.invalidate();
+}
+
+void GLTrace::setDumpFile(FILE *f)
+{
+    m_dumpFile = f;
+}
+
+void GLTrace::beginFrame()
+{
+    if(!m_enabled)
+        return;
+    for(int i = 0; i < EntryCount; i++)
+    {
+        m_calls[i] = 0;
+        m_redundant[i] = 0;
+        m_time[i] = 0.0;
+    }
+    // the application may change the state between frames
+    traceState.invalidate();
+    m_inFrame = true;
+}
+
+static bool compareCalls(const pair<uint32_t, int> &a, const pair<uint32_t, int> &b)
+{
+    return a.first > b.first;
+}
+
+void GLTrace::endFrame()
+{
+    if(!m_enabled || !m_inFrame)
+        return;
+    m_inFrame = false;
+
+    vector< pair<uint32_t, int> > entries;
+    uint32_t calls = 0, redundant = 0;
+    double time = 0.0;
+    for(int i = 0; i < EntryCount; i++)
+    {
+        if(m_calls[i] == 0)
+            continue;
+        calls += m_calls[i];
+        redundant += m_redundant[i];
+        time += m_time[i];
+        entries.push_back(make_pair(m_calls[i], i));
+    }
+    stable_sort(entries.begin(), entries.end(), compareCalls);
+
+    stringstream ss;
+    ss << "GL calls: " << calls << ", " << redundant << " redundant, "
+       << fixed << setprecision(3) << (time * 1000.0) << " ms in driver";
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        int e = entries[i].second;
+        ss << "\n  " << entryNames[e] << ": " << m_calls[e];
+        if(m_redundant[e] > 0)
+            ss << " (" << m_redundant[e] << " redundant)";
+        ss << ", " << setprecision(1) << (m_time[e] * 1e6) << " us";
+    }
+    m_report = ss.str();
+    if(m_dumpFile)
+        fprintf(m_dumpFile, "%s\n\n", m_report.c_str());
+}
+
+string GLTrace::report()
+{
+    return m_report;
+}
+
+GLTrace::Call::Call(Entry entry, bool redundant)
+{
+    m_entry = entry;
+    m_redundant = redundant;
+    m_start = GLTrace::m_inFrame ? traceTime() : 0.0;
+}
+
+GLTrace::Call::~Call()
+{
+    if(!GLTrace::m_inFrame)
+        return;
+    GLTrace::m_calls[m_entry]++;
+    if(m_redundant)
+        GLTrace::m_redundant[m_entry]++;
+    GLTrace::m_time[m_entry] += traceTime() - m_start;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Update the shadow state, returning true if the call would not change it.
+
+static bool redundant_glActiveTexture(GLenum texture)
+{
+    return update(traceState.activeTexture, texture - GL_TEXTURE0);
+}
+
+static bool redundant_glBindBuffer(GLenum target, GLuint buffer)
+{
+    return update(traceState.buffers, (uint32_t)target, (uint32_t)buffer);
+}
+
+static bool redundant_glBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    vector<uint64_t> range(1, buffer);
+    traceState.buffers[target] = buffer;
+    return update(traceState.ranges, key(target, index), range);
+}
+
+static bool redundant_glBindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                                        GLintptr offset, GLsizeiptr size)
+{
+    vector<uint64_t> range;
+    range.push_back(buffer);
+    range.push_back(offset);
+    range.push_back(size);
+    traceState.buffers[target] = buffer;
+    return update(traceState.ranges, key(target, index), range);
+}
+
+static bool redundant_glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    bool redundant = true;
+    if((target == GL_FRAMEBUFFER) || (target == GL_READ_FRAMEBUFFER))
+        redundant = update(traceState.readFramebuffer, framebuffer) && redundant;
+    if((target == GL_FRAMEBUFFER) || (target == GL_DRAW_FRAMEBUFFER))
+        redundant = update(traceState.drawFramebuffer, framebuffer) && redundant;
+    return redundant;
+}
+
+static bool redundant_glBindTexture(GLenum target, GLuint texture)
+{
+    if(traceState.activeTexture == Unknown)
+        return false;
+    return update(traceState.textures, key(traceState.activeTexture, target), (uint32_t)texture);
+}
+
+static bool redundant_glBindVertexArray(GLuint array)
+{
+    if(update(traceState.vertexArray, array))
+        return true;
+    // the element buffer binding is part of the vertex array
+    traceState.buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+    return false;
+}
+
+static bool redundant_glDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    (void)n;
+    (void)buffers;
+    traceState.buffers.clear();
+    traceState.ranges.clear();
+    traceState.pointers.clear();
+    return false;
+}
+
+static bool redundant_glDeleteTextures(GLsizei n, const GLuint *textures)
+{
+    (void)n;
+    (void)textures;
+    traceState.textures.clear();
+    return false;
+}
+
+static bool redundant_glDeleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+    (void)n;
+    (void)arrays;
+    traceState.vertexArray = Unknown;
+    traceState.invalidateVertexArrays();
+    return false;
+}
+
+static bool redundant_glDisable(GLenum cap)
+{
+    return update(traceState.caps, (uint32_t)cap, false);
+}
+
+static bool redundant_glEnable(GLenum cap)
+{
+    return update(traceState.caps, (uint32_t)cap, true);
+}
+
+static bool setAttribute(GLuint index, bool enabled)
+{
+    if(traceState.vertexArray == Unknown)
+        return false;
+    return update(traceState.attributes, key(traceState.vertexArray, index), enabled);
+}
+
+static bool redundant_glDisableVertexAttribArray(GLuint index)
+{
+    return setAttribute(index, false);
+}
+
+static bool redundant_glEnableVertexAttribArray(GLuint index)
+{
+    return setAttribute(index, true);
+}
+
+static bool redundant_glPopAttrib()
+{
+    traceState.caps.clear();
+    traceState.matrixMode = Unknown;
+    return false;
+}
+
+static bool setUniform(GLint location, const void *data, size_t size)
+{
+    if((traceState.program == Unknown) || (location < 0))
+        return false;
+    vector<uint32_t> values(size / sizeof(uint32_t));
+    memcpy(&values[0], data, size);
+    return update(traceState.uniforms, key(traceState.program, location), values);
+}
+
+static bool redundant_glUniform1f(GLint location, GLfloat v)
+{
+    return setUniform(location, &v, sizeof(GLfloat));
+}
+
+static bool redundant_glUniform1i(GLint location, GLint v)
+{
+    return setUniform(location, &v, sizeof(GLint));
+}
+
+static bool redundant_glUniform4fv(GLint location, GLsizei count, const GLfloat *v)
+{
+    return setUniform(location, v, count * 4 * sizeof(GLfloat));
+}
+
+static bool redundant_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose,
+                                         const GLfloat *v)
+{
+    (void)transpose;
+    return setUniform(location, v, count * 16 * sizeof(GLfloat));
+}
+
+static bool redundant_glUseProgram(GLuint program)
+{
+    return update(traceState.program, program);
+}
+
+static bool redundant_glVertexAttribDivisorARB(GLuint index, GLuint divisor)
+{
+    if(traceState.vertexArray == Unknown)
+        return false;
+    return update(traceState.divisors, key(traceState.vertexArray, index), (uint32_t)divisor);
+}
+
+static bool redundant_glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                            GLboolean normalized, GLsizei stride,
+                                            const void *pointer)
+{
+    map<uint32_t, uint32_t>::iterator it = traceState.buffers.find(GL_ARRAY_BUFFER);
+    if((traceState.vertexArray == Unknown) || (it == traceState.buffers.end()))
+        return false;
+    vector<uint64_t> attrib;
+    attrib.push_back(it->second);
+    attrib.push_back(size);
+    attrib.push_back(type);
+    attrib.push_back(normalized);
+    attrib.push_back(stride);
+    attrib.push_back((uint64_t)(size_t)pointer);
+    return update(traceState.pointers, key(traceState.vertexArray, index), attrib);
+}
+
+static bool redundant_glMatrixMode(GLenum mode)
+{
+    return update(traceState.matrixMode, mode);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define GL_TRACE_CALL(ret, name, params, args) \
+ret traced_##name params \
+{ \
+    GLTrace::Call call(GLTrace::name##Entry); \
+    return name args; \
+}
+
+#define GL_TRACE_TRACKED_CALL(ret, name, params, args) \
+ret traced_##name params \
+{ \
+    GLTrace::Call call(GLTrace::name##Entry, GLTrace::enabled() && redundant_##name args); \
+    return name args; \
+}
+
+GL_TRACE_ENTRIES(GL_TRACE_CALL, GL_TRACE_TRACKED_CALL)
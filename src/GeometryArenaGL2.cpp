@@ -0,0 +1,252 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "Platform.h"
+#include "GeometryArenaGL2.h"
+#include "StateCacheGL2.h"
+#include "GLTrace.h"
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+GeometryArenaGL2::GeometryArenaGL2(StateCacheGL2 *cache, int position, int normal,
+                                   int texCoords, int modelView)
+{
+    m_cache = cache;
+    m_position = position;
+    m_normal = normal;
+    m_texCoords = texCoords;
+    m_modelView = modelView;
+    m_useVertexArrays = false;
+    m_vertexArrays[0] = m_vertexArrays[1] = 0;
+    m_buffer = 0;
+    m_bufferSize = 0;
+    m_used = 0;
+    m_dirtyStart = m_dirtyEnd = 0;
+}
+
+GeometryArenaGL2::~GeometryArenaGL2()
+{
+    release();
+}
+
+void GeometryArenaGL2::setUseVertexArrays(bool use)
+{
+    m_useVertexArrays = use;
+}
+
+uint32_t GeometryArenaGL2::buffer() const
+{
+    return m_buffer;
+}
+
+uint32_t GeometryArenaGL2::capacity() const
+{
+    return m_vertices.size();
+}
+
+uint32_t GeometryArenaGL2::used() const
+{
+    return m_used;
+}
+
+uint32_t GeometryArenaGL2::blockSize(uint32_t order)
+{
+    return MinBlockSize << order;
+}
+
+uint32_t GeometryArenaGL2::blockOrder(uint32_t count)
+{
+    uint32_t order = 0;
+    while(blockSize(order) < count)
+        order++;
+    return order;
+}
+
+uint32_t GeometryArenaGL2::add(const VertexGroup *vg)
+{
+    uint32_t order = blockOrder(vg->count);
+    uint32_t first = allocate(order);
+    m_used += blockSize(order);
+    if(vg->count > 0)
+    {
+        copy(vg->data, vg->data + vg->count, m_vertices.begin() + first);
+        if(m_dirtyStart >= m_dirtyEnd)
+        {
+            m_dirtyStart = first;
+            m_dirtyEnd = first + vg->count;
+        }
+        else
+        {
+            m_dirtyStart = min(m_dirtyStart, first);
+            m_dirtyEnd = max(m_dirtyEnd, first + vg->count);
+        }
+    }
+    return first;
+}
+
+void GeometryArenaGL2::remove(uint32_t first, uint32_t count)
+{
+    uint32_t order = blockOrder(count);
+    m_used -= blockSize(order);
+    // merge the block with its buddy for as long as the buddy is free
+    uint32_t top = m_freeBlocks.size() - 1;
+    while(order < top)
+    {
+        uint32_t buddy = first ^ blockSize(order);
+        set<uint32_t>::iterator it = m_freeBlocks[order].find(buddy);
+        if(it == m_freeBlocks[order].end())
+            break;
+        m_freeBlocks[order].erase(it);
+        first = min(first, buddy);
+        order++;
+    }
+    m_freeBlocks[order].insert(first);
+}
+
+uint32_t GeometryArenaGL2::allocate(uint32_t order)
+{
+    uint32_t k = order;
+    while(true)
+    {
+        while((k < m_freeBlocks.size()) && m_freeBlocks[k].empty())
+            k++;
+        if(k < m_freeBlocks.size())
+            break;
+        grow();
+        k = order;
+    }
+    uint32_t first = *m_freeBlocks[k].begin();
+    m_freeBlocks[k].erase(m_freeBlocks[k].begin());
+    // split the block, keeping the first half each time
+    while(k > order)
+    {
+        k--;
+        m_freeBlocks[k].insert(first + blockSize(k));
+    }
+    return first;
+}
+
+void GeometryArenaGL2::grow()
+{
+    if(m_freeBlocks.empty())
+    {
+        m_freeBlocks.resize(InitialOrder + 1);
+        m_freeBlocks[InitialOrder].insert(0);
+        m_vertices.resize(blockSize(InitialOrder));
+        return;
+    }
+    // the new half of the arena is the buddy of the whole old arena
+    uint32_t top = m_freeBlocks.size() - 1;
+    uint32_t size = blockSize(top);
+    m_freeBlocks.resize(top + 2);
+    if(m_freeBlocks[top].count(0) > 0)
+    {
+        m_freeBlocks[top].erase(0);
+        m_freeBlocks[top + 1].insert(0);
+    }
+    else
+    {
+        m_freeBlocks[top].insert(size);
+    }
+    m_vertices.resize(2 * size);
+}
+
+bool GeometryArenaGL2::dirty() const
+{
+    return (m_vertices.size() > m_bufferSize) || (m_dirtyStart < m_dirtyEnd);
+}
+
+void GeometryArenaGL2::bind()
+{
+    if(m_buffer == 0)
+        glGenBuffers(1, &m_buffer);
+    m_cache->bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    if(m_vertices.size() > m_bufferSize)
+    {
+        // the arena grew, upload everything again
+        m_bufferSize = m_vertices.size();
+        glBufferData(GL_ARRAY_BUFFER, m_bufferSize * sizeof(VertexData),
+            &m_vertices[0], GL_STATIC_DRAW);
+    }
+    else if(m_dirtyStart < m_dirtyEnd)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, m_dirtyStart * sizeof(VertexData),
+            (m_dirtyEnd - m_dirtyStart) * sizeof(VertexData), &m_vertices[m_dirtyStart]);
+    }
+    m_dirtyStart = m_dirtyEnd = 0;
+}
+
+void GeometryArenaGL2::setAttributes()
+{
+    bind();
+    glVertexAttribPointer(m_position, 3, GL_FLOAT, GL_FALSE,
+        sizeof(VertexData), BUFFER_OFFSET(0));
+    glVertexAttribPointer(m_normal, 3, GL_FLOAT, GL_FALSE,
+        sizeof(VertexData), BUFFER_OFFSET(sizeof(vec3)));
+    glVertexAttribPointer(m_texCoords, 2, GL_FLOAT, GL_FALSE,
+        sizeof(VertexData), BUFFER_OFFSET(2 * sizeof(vec3)));
+}
+
+bool GeometryArenaGL2::bindVertexArray(bool instanced)
+{
+    if(!m_useVertexArrays)
+        return false;
+    uint32_t &array = m_vertexArrays[instanced ? 1 : 0];
+    if(array != 0)
+    {
+        m_cache->bindVertexArray(array);
+        // upload the vertices added since the array was built
+        if(dirty())
+            bind();
+        return true;
+    }
+    glGenVertexArrays(1, &array);
+    if(array == 0)
+        return false;
+    m_cache->bindVertexArray(array);
+    setAttributes();
+    glEnableVertexAttribArray(m_position);
+    glEnableVertexAttribArray(m_normal);
+    glEnableVertexAttribArray(m_texCoords);
+    for(int j = 0; instanced && (j < 4); j++)
+    {
+        glEnableVertexAttribArray(m_modelView + j);
+        glVertexAttribDivisorARB(m_modelView + j, 1);
+    }
+    return true;
+}
+
+void GeometryArenaGL2::release()
+{
+    for(int i = 0; i < 2; i++)
+    {
+        m_cache->deleteVertexArray(m_vertexArrays[i]);
+        m_vertexArrays[i] = 0;
+    }
+    if(m_buffer != 0)
+        m_cache->deleteBuffer(m_buffer);
+    m_buffer = 0;
+    m_bufferSize = 0;
+    m_dirtyStart = m_dirtyEnd = 0;
+}
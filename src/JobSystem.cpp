@@ -0,0 +1,276 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "JobSystem.h"
+
+using namespace std;
+
+JobSystem::Counter::Counter()
+{
+    m_pending = 0;
+}
+
+int JobSystem::Counter::pending() const
+{
+    return m_pending;
+}
+
+JobSystem::JobSystem(int threads)
+{
+    m_queued = 0;
+    m_changes = 0;
+    m_started = 0;
+    m_quit = false;
+    int count = max(threads, 0);
+    for(int i = 0; i <= count; i++)
+        m_queues.push_back(new Queue());
+    m_threads.resize(count);
+    for(int i = 0; i < count; i++)
+        m_threads[i].start(threadMain, this);
+}
+
+JobSystem::~JobSystem()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_changed.broadcast();
+    m_mutex.unlock();
+    for(size_t i = 0; i < m_threads.size(); i++)
+        m_threads[i].join();
+    for(size_t i = 0; i < m_queues.size(); i++)
+        delete m_queues[i];
+}
+
+JobSystem * JobSystem::shared()
+{
+    static JobSystem system(processorCount() - 1);
+    return &system;
+}
+
+int JobSystem::threadCount() const
+{
+    return (int)m_threads.size();
+}
+
+void JobSystem::submit(Task task, void *arg, int index, Counter *done, Counter *after)
+{
+    Job job;
+    job.task = task;
+    job.arg = arg;
+    job.first = index;
+    job.last = index + 1;
+    job.done = done;
+    if(done)
+        atomicAdd(&done->m_pending, 1);
+    if(after)
+    {
+        m_mutex.lock();
+        bool waiting = (after->m_pending > 0);
+        if(waiting)
+            after->m_waiting.push_back(job);
+        m_mutex.unlock();
+        if(waiting)
+            return;
+    }
+    queue(&job, 1);
+}
+
+void JobSystem::wait(Counter &counter)
+{
+    // the other jobs queued could be long ones, which a thread outside of
+    // the system should not be the one to run, unless there is nobody else
+    bool outside = (m_threadIndex.get() == 0) && !m_threads.empty();
+    const Counter *only = outside ? &counter : 0;
+    Job job;
+    while(true)
+    {
+        m_mutex.lock();
+        while((counter.m_pending > 0) && (m_queued == 0))
+            m_changed.wait(m_mutex);
+        bool done = (counter.m_pending == 0);
+        int changes = m_changes;
+        m_mutex.unlock();
+        if(done)
+            return;
+        if(takeJob(job, only))
+        {
+            runJob(job);
+            continue;
+        }
+        if(!only)
+            continue;
+        // the jobs of the counter are all running, sleep until one is done
+        m_mutex.lock();
+        while((counter.m_pending > 0) && (m_changes == changes))
+            m_changed.wait(m_mutex);
+        m_mutex.unlock();
+    }
+}
+
+void JobSystem::parallelFor(Task task, void *arg, int count, int grain)
+{
+    if(grain <= 0)
+        grain = count / ((m_threads.size() + 1) * 4);
+    grain = max(grain, 1);
+    if(m_threads.empty() || (count <= grain))
+    {
+        for(int i = 0; i < count; i++)
+            task(arg, i);
+        return;
+    }
+    Counter done;
+    vector<Job> jobs;
+    for(int first = 0; first < count; first += grain)
+    {
+        Job job;
+        job.task = task;
+        job.arg = arg;
+        job.first = first;
+        job.last = min(first + grain, count);
+        job.done = &done;
+        jobs.push_back(job);
+    }
+    atomicAdd(&done.m_pending, jobs.size());
+    queue(&jobs[0], jobs.size());
+    wait(done);
+}
+
+void JobSystem::threadMain(void *arg)
+{
+    JobSystem *system = (JobSystem *)arg;
+    system->work(atomicAdd(&system->m_started, 1) - 1);
+}
+
+void JobSystem::work(int index)
+{
+    m_threadIndex.set((void *)(size_t)(index + 1));
+    Job job;
+    while(true)
+    {
+        if(takeJob(job))
+        {
+            runJob(job);
+            continue;
+        }
+        m_mutex.lock();
+        while(!m_quit && (m_queued == 0))
+            m_changed.wait(m_mutex);
+        bool quit = m_quit;
+        m_mutex.unlock();
+        if(quit)
+            break;
+    }
+}
+
+int JobSystem::currentQueue() const
+{
+    size_t index = (size_t)m_threadIndex.get();
+    return (index > 0) ? (int)(index - 1) : (int)m_threads.size();
+}
+
+void JobSystem::queue(const Job *jobs, int count)
+{
+    Queue *q = m_queues[currentQueue()];
+    q->mutex.lock();
+    for(int i = 0; i < count; i++)
+        q->jobs.push_back(jobs[i]);
+    q->mutex.unlock();
+    atomicAdd(&m_queued, count);
+    m_mutex.lock();
+    m_changes++;
+    m_changed.broadcast();
+    m_mutex.unlock();
+}
+
+// the newest job of the thread's own queue, whose data is likely in its
+// cache, otherwise the oldest job of another queue. Only jobs counted on
+// the given counter are taken, if any.
+bool JobSystem::takeJob(Job &job, const Counter *only)
+{
+    if(m_queued == 0)
+        return false;
+    int first = currentQueue();
+    int count = m_queues.size();
+    for(int i = 0; i < count; i++)
+    {
+        Queue *q = m_queues[(first + i) % count];
+        q->mutex.lock();
+        bool found = !q->jobs.empty();
+        if(found && only)
+            found = takeJobOf(q->jobs, only, i == 0, job);
+        else if(found && (i == 0))
+        {
+            job = q->jobs.back();
+            q->jobs.pop_back();
+        }
+        else if(found)
+        {
+            job = q->jobs.front();
+            q->jobs.pop_front();
+        }
+        q->mutex.unlock();
+        if(found)
+        {
+            atomicAdd(&m_queued, -1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::takeJobOf(deque<Job> &jobs, const Counter *counter, bool newest, Job &job)
+{
+    for(size_t i = 0; i < jobs.size(); i++)
+    {
+        size_t index = newest ? (jobs.size() - 1 - i) : i;
+        if(jobs[index].done == counter)
+        {
+            job = jobs[index];
+            jobs.erase(jobs.begin() + index);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::runJob(const Job &job)
+{
+    for(int i = job.first; i < job.last; i++)
+        job.task(job.arg, i);
+    if(!job.done)
+        return;
+    // the counter can be gone as soon as it is seen at zero, so it is only
+    // changed with the mutex locked, as wait looks at it
+    vector<Job> released;
+    m_mutex.lock();
+    if(atomicAdd(&job.done->m_pending, -1) == 0)
+    {
+        released.swap(job.done->m_waiting);
+        m_changes++;
+        m_changed.broadcast();
+    }
+    m_mutex.unlock();
+    if(!released.empty())
+        queue(&released[0], released.size());
+}
@@ -34,6 +34,7 @@ Material::Material()
     m_specular = vec4(0.0, 0.0, 0.0, 0.0);
     m_shine = 0.0;
     m_texture = 0;
+    m_id = nextID();
 }
 
 Material::Material(vec4 ambient, vec4 diffuse, vec4 specular, float shine)
@@ -43,6 +44,18 @@ Material::Material(vec4 ambient, vec4 diffuse, vec4 specular, float shine)
     m_specular = specular;
     m_shine = shine;
     m_texture = 0;
+    m_id = nextID();
+}
+
+uint32_t Material::nextID()
+{
+    static uint32_t lastID = 0;
+    return ++lastID;
+}
+
+uint32_t Material::id() const
+{
+    return m_id;
 }
 
 const vec4 & Material::ambient() const
@@ -68,21 +81,25 @@ float Material::shine() const
 void Material::setAmbient(const vec4 &ambient)
 {
     m_ambient = ambient;
+    m_id = nextID();
 }
 
 void Material::setDiffuse(const vec4 &diffuse)
 {
     m_diffuse = diffuse;
+    m_id = nextID();
 }
 
 void Material::setSpecular(const vec4 &specular)
 {
     m_specular = specular;
+    m_id = nextID();
 }
 
 void Material::setShine(float shine)
 {
     m_shine = shine;
+    m_id = nextID();
 }
 
 uint32_t Material::texture() const
@@ -93,6 +110,7 @@ uint32_t Material::texture() const
 void Material::setTexture(uint32_t texture)
 {
     m_texture = texture;
+    m_id = nextID();
 }
 
 void Material::freeTexture()
@@ -101,6 +119,7 @@ void Material::freeTexture()
     {
         glDeleteTextures(1, &m_texture);
         m_texture = 0;
+        m_id = nextID();
     }
 }
 
@@ -118,11 +137,13 @@ void setTextureParams(uint32_t target, bool mipmaps)
 void Material::loadTextureTIFF(string path, bool mipmaps)
 {
     m_texture = textureFromTIFFImage(path, mipmaps);
+    m_id = nextID();
 }
 
 void Material::loadTextureTIFF(const char *data, size_t size, bool mipmaps)
 {
     m_texture = textureFromTIFFImage(data, size, mipmaps);
+    m_id = nextID();
 }
 
 uint32_t textureFromTIFF(TIFF *tiff, bool mipmaps)
@@ -22,6 +22,7 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cmath>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
@@ -32,6 +33,8 @@
 #include "Material.h"
 #include "RenderState.h"
 #include "Platform.h"
+#include "TriangleTree.h"
+#include "JobSystem.h"
 
 #ifdef JNI_WRAPPER
 #define GL_TRIANGLES				0x0004
@@ -48,10 +51,99 @@ using namespace std;
 
 Mesh::Mesh()
 {
+    static uint32_t lastID = 0;
+    m_id = ++lastID;
+    m_boundsMin = m_boundsMax = m_boundsCenter = vec3(0.0, 0.0, 0.0);
+    m_boundsRadius = -1.0;
+    m_triangles = new TriangleTree();
 }
 
 Mesh::~Mesh()
 {
+    delete m_triangles;
+}
+
+uint32_t Mesh::id() const
+{
+    return m_id;
+}
+
+bool Mesh::hasBounds() const
+{
+    return m_boundsRadius >= 0.0;
+}
+
+const vec3 & Mesh::boundsMin() const
+{
+    return m_boundsMin;
+}
+
+const vec3 & Mesh::boundsMax() const
+{
+    return m_boundsMax;
+}
+
+const vec3 & Mesh::boundsCenter() const
+{
+    return m_boundsCenter;
+}
+
+float Mesh::boundsRadius() const
+{
+    return m_boundsRadius;
+}
+
+const TriangleTree * Mesh::triangles() const
+{
+    return m_triangles;
+}
+
+void Mesh::addTriangles(const VertexGroup *vg)
+{
+    if((vg->mode != GL_TRIANGLES) || (vg->count < 3))
+        return;
+    // build the tree again with the triangles of every group
+    vector<vec3> positions = m_triangles->positions();
+    for(uint32_t i = 0; (i + 2) < vg->count; i += 3)
+    {
+        for(int j = 0; j < 3; j++)
+            positions.push_back(vg->data[i + j].position);
+    }
+    m_triangles->build(positions);
+}
+
+void Mesh::addBounds(const VertexGroup *vg)
+{
+    if(vg->count == 0)
+        return;
+    vec3 lo = vg->data[0].position, hi = lo;
+    for(uint32_t i = 1; i < vg->count; i++)
+    {
+        const vec3 &p = vg->data[i].position;
+        lo = vec3(min(lo.x, p.x), min(lo.y, p.y), min(lo.z, p.z));
+        hi = vec3(max(hi.x, p.x), max(hi.y, p.y), max(hi.z, p.z));
+    }
+    // the sphere is centered on the box, which is tighter than the box's sphere
+    vec3 center((lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f);
+    float radius2 = 0.0;
+    for(uint32_t i = 0; i < vg->count; i++)
+    {
+        vec3 d = vg->data[i].position - center;
+        radius2 = max(radius2, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+    float radius = sqrt(radius2);
+
+    if(!hasBounds())
+    {
+        m_boundsMin = lo;
+        m_boundsMax = hi;
+        m_boundsCenter = center;
+        m_boundsRadius = radius;
+        return;
+    }
+    m_boundsMin = vec3(min(m_boundsMin.x, lo.x), min(m_boundsMin.y, lo.y), min(m_boundsMin.z, lo.z));
+    m_boundsMax = vec3(max(m_boundsMax.x, hi.x), max(m_boundsMax.y, hi.y), max(m_boundsMax.z, hi.z));
+    mergeSpheres(m_boundsCenter, m_boundsRadius, center, radius);
 }
 
 /* Show the normal for every vertex in the mesh, for debugging purposes. */
@@ -319,6 +411,15 @@ void Mesh::saveStl(string path, VertexGroup **vg, int groups)
     fclose(f);
 }
 
+// text of an OBJ file, made in jobs by sections of groups
+typedef struct
+{
+    VertexGroup **vg;
+    int groups;
+    vector<uint32_t> offsets;   // of the first index of every group
+    vector<string> text;        // positions, coordinates, normals then faces
+} ObjText;
+
 void Mesh::saveObj(string path, VertexGroup **vg, int groups)
 {
     if(!vg)
@@ -329,99 +430,117 @@ void Mesh::saveObj(string path, VertexGroup **vg, int groups)
         fprintf(stderr, "Could not open file '%s' for writing.\n", path.c_str());
         return;
     }
+    ObjText t;
+    t.vg = vg;
+    t.groups = groups;
+    uint32_t offset = 0;
     for(int i = 0; i < groups; i++)
     {
-        VertexGroup *g = vg[i];
-        for(uint32_t j = 0; j < g->count; j++)
-        {
-            vec3 vertex = g->data[j].position;
-            fprintf(f, "v %f %f %f\n", vertex.x, vertex.y, vertex.z);
-        }
+        t.offsets.push_back(offset);
+        offset += objIndexCount(vg[i]);
     }
-    for(int i = 0; i < groups; i++)
+    t.text.resize(groups * 4);
+    JobSystem::shared()->parallelFor(saveObjTask, &t, groups * 4);
+    for(size_t i = 0; i < t.text.size(); i++)
+        fwrite(t.text[i].data(), 1, t.text[i].size(), f);
+    fclose(f);
+}
+
+void Mesh::saveObjTask(void *arg, int index)
+{
+    ObjText *t = (ObjText *)arg;
+    int section = index / t->groups;
+    VertexGroup *g = t->vg[index % t->groups];
+    string &out = t->text[index];
+    char line[256];
+    for(uint32_t j = 0; (section < 3) && (j < g->count); j++)
     {
-        VertexGroup *g = vg[i];
-        for(uint32_t j = 0; j < g->count; j++)
-        {
-            vec2 texCoords = g->data[j].texCoords;
-            fprintf(f, "vt %f %f\n", texCoords.x, texCoords.y);
-        }
+        const VertexData &d = g->data[j];
+        if(section == 0)
+            snprintf(line, sizeof(line), "v %f %f %f\n", d.position.x, d.position.y, d.position.z);
+        else if(section == 1)
+            snprintf(line, sizeof(line), "vt %f %f\n", d.texCoords.x, d.texCoords.y);
+        else
+            snprintf(line, sizeof(line), "vn %f %f %f\n", d.normal.x, d.normal.y, d.normal.z);
+        out.append(line);
     }
-    for(int i = 0; i < groups; i++)
+    if(section < 3)
+        return;
+    uint32_t offset = t->offsets[index % t->groups];
+    switch(g->mode)
     {
-        VertexGroup *g = vg[i];
-        for(uint32_t j = 0; j < g->count; j++)
-        {
-            vec3 normal = g->data[j].normal;
-            fprintf(f, "vn %f %f %f\n", normal.x, normal.y, normal.z);
-        }
+    case GL_TRIANGLES:
+        saveObjIndicesTri(out, g, offset);
+        break;
+    case GL_QUADS:
+        saveObjIndicesQuad(out, g, offset);
+        break;
+    case GL_TRIANGLE_STRIP:
+        saveObjIndicesTriStrip(out, g, offset);
+        break;
     }
-    uint32_t offset = 0;
-    for(int i = 0; i < groups; i++)
+}
+
+// how far the indices of the faces of a group move the next group's
+uint32_t Mesh::objIndexCount(VertexGroup *vg)
+{
+    switch(vg->mode)
     {
-        VertexGroup *g = vg[i];
-        switch(g->mode)
-        {
-        case GL_TRIANGLES:
-            saveObjIndicesTri(f, g, offset);
-            break;
-        case GL_QUADS:
-            saveObjIndicesQuad(f, g, offset);
-            break;
-        case GL_TRIANGLE_STRIP:
-            saveObjIndicesTriStrip(f, g, offset);
-            break;
-        }
+    case GL_TRIANGLES:
+        return vg->count;
+    case GL_QUADS:
+        return (vg->count * 6) / 4;
+    case GL_TRIANGLE_STRIP:
+        return (vg->count - 2) * 3;
     }
-    fclose(f);
+    return 0;
 }
 
-void Mesh::saveObjIndicesTri(FILE *f, VertexGroup *vg, uint32_t &offset)
+void Mesh::saveObjIndicesTri(string &out, VertexGroup *vg, uint32_t offset)
 {
     uint32_t endOffset = offset + vg->count - 2;
     for(uint32_t i = offset; i < endOffset; i += 3)
-        saveObjFace(f, i, i + 1, i + 2);
-    offset += vg->count;
+        saveObjFace(out, i, i + 1, i + 2);
 }
 
-void Mesh::saveObjIndicesQuad(FILE *f, VertexGroup *vg, uint32_t &offset)
+void Mesh::saveObjIndicesQuad(string &out, VertexGroup *vg, uint32_t offset)
 {
     uint32_t endOffset = offset + vg->count - 3;
     for(uint32_t i = offset; i < endOffset; i += 4)
     {
-        saveObjFace(f, i, i + 1, i + 2);
-        saveObjFace(f, i, i + 2, i + 3);
+        saveObjFace(out, i, i + 1, i + 2);
+        saveObjFace(out, i, i + 2, i + 3);
     }
-    offset += (vg->count * 6) / 4;
 }
 
-void Mesh::saveObjIndicesTriStrip(FILE *f, VertexGroup *vg, uint32_t &offset)
+void Mesh::saveObjIndicesTriStrip(string &out, VertexGroup *vg, uint32_t offset)
 {
     uint32_t endOffset = offset + vg->count - 2;
     for(uint32_t i = offset; i < endOffset; i++)
-        saveObjFace(f, i, i + 1, i + 2);
-    offset += (vg->count - 2) * 3;
+        saveObjFace(out, i, i + 1, i + 2);
 }
 
-void Mesh::saveObjFace(FILE *f, uint32_t ind1, uint32_t ind2, uint32_t ind3)
+void Mesh::saveObjFace(string &out, uint32_t ind1, uint32_t ind2, uint32_t ind3)
 {
-    fprintf(f, "f ");
-    saveObjIndice(f, ind1 + 1);
-    fprintf(f, " ");
-    saveObjIndice(f, ind2 + 1);
-    fprintf(f, " ");
-    saveObjIndice(f, ind3 + 1);
-    fprintf(f, "\n");
+    out.append("f ");
+    saveObjIndice(out, ind1 + 1);
+    out.append(" ");
+    saveObjIndice(out, ind2 + 1);
+    out.append(" ");
+    saveObjIndice(out, ind3 + 1);
+    out.append("\n");
 }
 
-void Mesh::saveObjIndice(FILE *f, uint32_t ind)
+void Mesh::saveObjIndice(string &out, uint32_t ind)
 {
+    char text[48];
     //if(texCoords && normals)
-        fprintf(f, "%d/%d/%d", ind, ind, ind);
+        snprintf(text, sizeof(text), "%d/%d/%d", ind, ind, ind);
     //else if(normals)
-    //    fprintf(f, "%d//%d", ind, ind);
+    //    snprintf(text, sizeof(text), "%d//%d", ind, ind);
     //else if(texCoords)
-    //    fprintf(f, "%d/%d", ind, ind);
+    //    snprintf(text, sizeof(text), "%d/%d", ind, ind);
     //else
-    //    fprintf(f, "%d", ind);
+    //    snprintf(text, sizeof(text), "%d", ind);
+    out.append(text);
 }
@@ -26,6 +26,9 @@
 #include "MeshGL1.h"
 #include "Material.h"
 #include "RenderState.h"
+#ifndef JNI_WRAPPER
+#include "GLTrace.h"
+#endif
 
 MeshGL1::MeshGL1() : Mesh()
 {
@@ -72,6 +75,8 @@ void MeshGL1::addGroup(VertexGroup *vg)
         m_texCoords[i] = v->texCoords;
     }
     addFace(vg->mode, vg->count, destOffset);
+    addBounds(vg);
+    addTriangles(vg);
 }
 
 bool MeshGL1::copyGroupTo(int index, VertexGroup *vg) const
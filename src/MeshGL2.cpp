@@ -28,8 +28,9 @@
 #include "Material.h"
 #include "RenderState.h"
 #include "RenderStateGL2.h"
-
-#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+#include "StateCacheGL2.h"
+#include "GeometryArenaGL2.h"
+#include "GLTrace.h"
 
 MeshGL2::MeshGL2(const RenderStateGL2 *state) : Mesh()
 {
@@ -41,11 +42,11 @@ MeshGL2::~MeshGL2()
     for(uint32_t i = 0; i < m_groups.size(); i++)
     {
         VertexGroup *vg = m_groups[i];
-        if(vg->id != 0)
-            glDeleteBuffers(1, &vg->id);
+        m_state->arena()->remove(m_first[i], vg->count);
         delete vg;
     }
     m_groups.clear();
+    m_first.clear();
 }
 
 int MeshGL2::groupCount() const
@@ -75,6 +76,16 @@ void MeshGL2::addGroup(VertexGroup *vg)
     uint32_t size = vg->count * sizeof(VertexData);
     memcpy(copy->data, vg->data, size);
     m_groups.push_back(copy);
+    m_first.push_back(m_state->arena()->add(copy));
+    addBounds(vg);
+    addTriangles(vg);
+}
+
+uint32_t MeshGL2::groupFirst(int index) const
+{
+    if((index < 0) || (index >= groupCount()))
+        return 0;
+    return m_first[index];
 }
 
 bool MeshGL2::copyGroupTo(int index, VertexGroup *vg) const
@@ -93,60 +104,33 @@ void MeshGL2::draw(Mesh::OutputMode mode, RenderState *s, Mesh *output)
     (void)mode;
     (void)s;
     (void)output;
-    drawToScreen();
+    drawToScreen(0);
 }
 
-void MeshGL2::drawToScreen()
+void MeshGL2::drawInstances(uint32_t instances)
 {
-    int position = m_state->positionAttr();
-    int normal = m_state->normalAttr();
-    int texCoords = m_state->texCoordsAttr();
-    glEnableVertexAttribArray(position);
-    glEnableVertexAttribArray(normal);
-    glEnableVertexAttribArray(texCoords);
-    for(uint32_t i = 0; i < m_groups.size(); i++)
-    {
-        VertexGroup *vg = m_groups[i];
-        if(vg->count > 100)
-            drawVBO(vg, position, normal, texCoords);
-        else
-            drawArray(vg, position, normal, texCoords);
-    }
-    glDisableVertexAttribArray(position);
-    glDisableVertexAttribArray(normal);
-    glDisableVertexAttribArray(texCoords);
+    if(instances > 0)
+        drawToScreen(instances);
 }
 
-void MeshGL2::drawArray(VertexGroup *vg, int position, int normal, int texCoords)
+void MeshGL2::drawToScreen(uint32_t instances)
 {
-    glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData), &vg->data->position);
-    glVertexAttribPointer(normal, 3, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData), &vg->data->normal);
-    glVertexAttribPointer(texCoords, 2, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData), &vg->data->texCoords);
-    glDrawArrays(vg->mode, 0, vg->count);
+    GeometryArenaGL2 *arena = m_state->arena();
+    if(!arena->bindVertexArray(instances > 0))
+    {
+        // the arrays stay enabled until the end of the frame
+        m_state->cache()->enableAttributes(m_state->attributeMask());
+        // the pointers are the same for every group in the arena
+        arena->setAttributes();
+    }
+    for(uint32_t i = 0; i < m_groups.size(); i++)
+        drawGroup(m_groups[i], m_first[i], instances);
 }
 
-void MeshGL2::drawVBO(VertexGroup *vg, int position, int normal, int texCoords)
+void MeshGL2::drawGroup(VertexGroup *vg, uint32_t first, uint32_t instances)
 {
-    if(vg->id == 0)
-    {
-        uint32_t size = vg->count * sizeof(VertexData);
-        glGenBuffers(1, &vg->id);
-        glBindBuffer(GL_ARRAY_BUFFER, vg->id);
-        glBufferData(GL_ARRAY_BUFFER, size, vg->data, GL_STATIC_DRAW);
-    }
+    if(instances > 0)
+        glDrawArraysInstancedARB(vg->mode, first, vg->count, instances);
     else
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, vg->id);
-    }
-    glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData), BUFFER_OFFSET(0));
-    glVertexAttribPointer(normal, 3, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData), BUFFER_OFFSET(sizeof(vec3)));
-    glVertexAttribPointer(texCoords, 2, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData), BUFFER_OFFSET(2 * sizeof(vec3)));
-    glDrawArrays(vg->mode, 0, vg->count);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDrawArrays(vg->mode, first, vg->count);
 }
@@ -0,0 +1,281 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "OcclusionCuller.h"
+#include "Mesh.h"
+#include "Platform.h"
+#ifdef HAVE_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+{
+    m_tilesX = (width + TileSize - 1) / TileSize;
+    m_tilesY = (height + TileSize - 1) / TileSize;
+    m_width = m_tilesX * TileSize;
+    m_height = m_tilesY * TileSize;
+    m_depth.resize(m_width * m_height, FLT_MAX);
+    m_eroded.resize(m_width * m_height, FLT_MAX);
+    m_tileDepth.resize(m_tilesX * m_tilesY, FLT_MAX);
+    m_projection.setIdentity();
+    m_occluderTriangles = 0;
+}
+
+void OcclusionCuller::begin(const matrix4 &projection)
+{
+    m_projection = projection;
+    fill(m_depth.begin(), m_depth.end(), FLT_MAX);
+    m_occluderTriangles = 0;
+}
+
+const vector<vec3> & OcclusionCuller::meshTriangles(Mesh *m)
+{
+    // keep a copy of the positions, the meshes only store them for the GPU
+    map<uint32_t, vector<vec3> >::iterator it = m_triangles.find(m->id());
+    if(it != m_triangles.end())
+        return it->second;
+    vector<vec3> &positions = m_triangles[m->id()];
+    for(int i = 0; i < m->groupCount(); i++)
+    {
+        if(m->groupMode(i) != GL_TRIANGLES)
+            continue;
+        VertexGroup vg(GL_TRIANGLES, m->groupSize(i));
+        if(!m->copyGroupTo(i, &vg))
+            continue;
+        for(uint32_t j = 0; j < vg.count; j++)
+            positions.push_back(vg.data[j].position);
+    }
+    return positions;
+}
+
+vec4 OcclusionCuller::project(const matrix4 &m, const vec3 &v) const
+{
+    const float *d = m.d;
+    return vec4(d[0] * v.x + d[4] * v.y + d[8] * v.z + d[12],
+                d[1] * v.x + d[5] * v.y + d[9] * v.z + d[13],
+                d[2] * v.x + d[6] * v.y + d[10] * v.z + d[14],
+                d[3] * v.x + d[7] * v.y + d[11] * v.z + d[15]);
+}
+
+void OcclusionCuller::addOccluder(Mesh *m, const matrix4 &modelView)
+{
+    const vector<vec3> &positions = meshTriangles(m);
+    matrix4 mvp = m_projection * modelView;
+    for(size_t i = 0; i + 2 < positions.size(); i += 3)
+    {
+        vec4 clip[3];
+        for(int j = 0; j < 3; j++)
+            clip[j] = project(mvp, positions[i + j]);
+        drawTriangle(clip);
+    }
+}
+
+void OcclusionCuller::drawTriangle(const vec4 *clip)
+{
+    // triangles crossing the near plane are skipped rather than clipped
+    float x[3], y[3], z = -FLT_MAX;
+    for(int i = 0; i < 3; i++)
+    {
+        if(clip[i].w <= 1e-5f)
+            return;
+        x[i] = (clip[i].x / clip[i].w * 0.5f + 0.5f) * m_width;
+        y[i] = (clip[i].y / clip[i].w * 0.5f + 0.5f) * m_height;
+        z = max(z, clip[i].z / clip[i].w);
+    }
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if(fabs(area) < 1e-6f)
+        return;
+    if(area < 0.0)
+    {
+        swap(x[1], x[2]);
+        swap(y[1], y[2]);
+    }
+
+    int minX = max(0, (int)floor(min(x[0], min(x[1], x[2]))));
+    int maxX = min(m_width - 1, (int)ceil(max(x[0], max(x[1], x[2]))));
+    int minY = max(0, (int)floor(min(y[0], min(y[1], y[2]))));
+    int maxY = min(m_height - 1, (int)ceil(max(y[0], max(y[1], y[2]))));
+    if((minX > maxX) || (minY > maxY))
+        return;
+    minX &= ~3;
+    m_occluderTriangles++;
+
+    // edge functions are positive inside, pixels are covered by their center
+    float a[3], b[3], c[3];
+    for(int i = 0; i < 3; i++)
+    {
+        int j = (i + 1) % 3;
+        a[i] = y[i] - y[j];
+        b[i] = x[j] - x[i];
+        c[i] = x[i] * y[j] - x[j] * y[i];
+    }
+
+#ifdef HAVE_SSE
+    __m128 depth = _mm_set1_ps(z);
+    __m128 zero = _mm_setzero_ps();
+    __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+    for(int py = minY; py <= maxY; py++)
+    {
+        float cy = py + 0.5f;
+        __m128 row0 = _mm_set1_ps(b[0] * cy + c[0]);
+        __m128 row1 = _mm_set1_ps(b[1] * cy + c[1]);
+        __m128 row2 = _mm_set1_ps(b[2] * cy + c[2]);
+        float *line = &m_depth[py * m_width];
+        for(int px = minX; px <= maxX; px += 4)
+        {
+            __m128 cx = _mm_add_ps(_mm_set1_ps((float)px), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, cx), row0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, cx), row1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, cx), row2);
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                            _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+            if(_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 old = _mm_loadu_ps(line + px);
+            __m128 nearest = _mm_min_ps(old, depth);
+            _mm_storeu_ps(line + px, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for(int py = minY; py <= maxY; py++)
+    {
+        float cy = py + 0.5f;
+        float *line = &m_depth[py * m_width];
+        for(int px = minX; px <= maxX; px++)
+        {
+            float cx = px + 0.5f;
+            if((a[0] * cx + b[0] * cy + c[0] >= 0.0) &&
+               (a[1] * cx + b[1] * cy + c[1] >= 0.0) &&
+               (a[2] * cx + b[2] * cy + c[2] >= 0.0))
+                line[px] = min(line[px], z);
+        }
+    }
+#endif
+}
+
+void OcclusionCuller::end()
+{
+    // a pixel is only as near as its farthest neighbour, so pixels on the
+    // edges of occluders, which are partly covered, are not occluders anymore
+    for(int py = 0; py < m_height; py++)
+    {
+        const float *line = &m_depth[py * m_width];
+        float *eroded = &m_eroded[py * m_width];
+        for(int px = 0; px < m_width; px++)
+        {
+            float left = line[max(px - 1, 0)], right = line[min(px + 1, m_width - 1)];
+            eroded[px] = max(line[px], max(left, right));
+        }
+    }
+    for(int py = 0; py < m_height; py++)
+    {
+        const float *above = &m_eroded[max(py - 1, 0) * m_width];
+        const float *below = &m_eroded[min(py + 1, m_height - 1) * m_width];
+        float *line = &m_depth[py * m_width];
+#ifdef HAVE_SSE
+        for(int px = 0; px < m_width; px += 4)
+        {
+            __m128 v = _mm_max_ps(_mm_loadu_ps(above + px), _mm_loadu_ps(below + px));
+            _mm_storeu_ps(line + px, _mm_max_ps(v, _mm_loadu_ps(&m_eroded[py * m_width + px])));
+        }
+#else
+        for(int px = 0; px < m_width; px++)
+            line[px] = max(m_eroded[py * m_width + px], max(above[px], below[px]));
+#endif
+    }
+
+    for(int ty = 0; ty < m_tilesY; ty++)
+    {
+        for(int tx = 0; tx < m_tilesX; tx++)
+        {
+            float farthest = -FLT_MAX;
+            for(int py = ty * TileSize; py < (ty + 1) * TileSize; py++)
+            {
+                const float *line = &m_depth[py * m_width + tx * TileSize];
+                for(int px = 0; px < TileSize; px++)
+                    farthest = max(farthest, line[px]);
+            }
+            m_tileDepth[ty * m_tilesX + tx] = farthest;
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const vec3 &center, float radius) const
+{
+    if(m_occluderTriangles == 0)
+        return false;
+    // screen rectangle and nearest depth of the box around the sphere
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, z = FLT_MAX;
+    for(int i = 0; i < 8; i++)
+    {
+        vec3 corner(center.x + ((i & 1) ? radius : -radius),
+                    center.y + ((i & 2) ? radius : -radius),
+                    center.z + ((i & 4) ? radius : -radius));
+        vec4 clip = project(m_projection, corner);
+        if(clip.w <= 1e-5f)
+            return false;
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * m_height;
+        minX = min(minX, x);
+        maxX = max(maxX, x);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+        z = min(z, clip.z / clip.w);
+    }
+    int x0 = max(0, (int)floor(minX)), x1 = min(m_width - 1, (int)floor(maxX));
+    int y0 = max(0, (int)floor(minY)), y1 = min(m_height - 1, (int)floor(maxY));
+    if((x0 > x1) || (y0 > y1))
+        return false;
+
+    for(int ty = y0 / TileSize; ty <= y1 / TileSize; ty++)
+    {
+        for(int tx = x0 / TileSize; tx <= x1 / TileSize; tx++)
+        {
+            // the whole tile is nearer than the sphere
+            if(m_tileDepth[ty * m_tilesX + tx] < z)
+                continue;
+            int py0 = max(y0, ty * TileSize), py1 = min(y1, (ty + 1) * TileSize - 1);
+            int px0 = max(x0, tx * TileSize), px1 = min(x1, (tx + 1) * TileSize - 1);
+            for(int py = py0; py <= py1; py++)
+            {
+                const float *line = &m_depth[py * m_width];
+                for(int px = px0; px <= px1; px++)
+                {
+                    if(line[px] >= z)
+                        return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int OcclusionCuller::occluderTriangles() const
+{
+    return m_occluderTriangles;
+}
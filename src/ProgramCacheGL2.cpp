@@ -0,0 +1,168 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include <vector>
+#include "Platform.h"
+#include "ProgramCacheGL2.h"
+
+static const uint32_t BinaryMagic = 0x42505247;
+static const uint32_t BinaryVersion = 1;
+
+// FNV-1a
+static uint64_t hashString(const string &s)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < s.size(); i++)
+    {
+        hash ^= (uint8_t)s[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static string glString(GLenum name)
+{
+    const GLubyte *s = glGetString(name);
+    return s ? string((const char *)s) : string();
+}
+
+ProgramCacheGL2::ProgramCacheGL2()
+{
+    m_checked = false;
+    m_supported = false;
+}
+
+void ProgramCacheGL2::setDirectory(string dir)
+{
+    m_directory = dir;
+}
+
+bool ProgramCacheGL2::enabled()
+{
+    if(!m_checked)
+    {
+        GLint formats = 0;
+        if(GLEW_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        m_supported = (formats > 0);
+        m_driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n"
+            + glString(GL_VERSION) + "\n";
+        m_checked = true;
+    }
+    return m_supported && !m_directory.empty();
+}
+
+string ProgramCacheGL2::path(const string &identity) const
+{
+    char name[32];
+    sprintf(name, "%016llx.bin", (unsigned long long)hashString(identity));
+    return m_directory + "/" + name;
+}
+
+uint32_t ProgramCacheGL2::load(const string &source)
+{
+    if(!enabled())
+        return 0;
+    string identity = m_driver + source;
+    FILE *f = fopen(path(identity).c_str(), "rb");
+    if(!f)
+        return 0;
+
+    // header: magic, version, binary format, identity size
+    uint32_t header[4];
+    bool valid = (fread(header, sizeof(header), 1, f) == 1)
+        && (header[0] == BinaryMagic) && (header[1] == BinaryVersion)
+        && (header[3] == identity.size());
+    vector<char> stored, binary;
+    if(valid)
+    {
+        // make sure the binary was not stored for a different program
+        stored.resize(identity.size());
+        valid = (fread(&stored[0], 1, stored.size(), f) == stored.size())
+            && (identity.compare(0, identity.size(), &stored[0], stored.size()) == 0);
+    }
+    if(valid)
+    {
+        long start = ftell(f);
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f) - start;
+        fseek(f, start, SEEK_SET);
+        valid = (size > 0);
+        if(valid)
+        {
+            binary.resize((size_t)size);
+            valid = (fread(&binary[0], 1, binary.size(), f) == binary.size());
+        }
+    }
+    fclose(f);
+    if(!valid)
+        return 0;
+
+    uint32_t program = glCreateProgram();
+    if(program == 0)
+        return 0;
+    glProgramBinary(program, header[2], &binary[0], (GLsizei)binary.size());
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(!status)
+    {
+        // the program needs to be compiled again, e.g. the driver was updated
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCacheGL2::store(uint32_t program, const string &source)
+{
+    if((program == 0) || !enabled())
+        return;
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if(size <= 0)
+        return;
+    vector<char> binary((size_t)size);
+    GLsizei length = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &length, &format, &binary[0]);
+    if(length <= 0)
+        return;
+
+    string identity = m_driver + source;
+    string filePath = path(identity);
+    FILE *f = fopen(filePath.c_str(), "wb");
+    if(!f)
+    {
+        fprintf(stderr, "Could not open file '%s' for writing.\n", filePath.c_str());
+        return;
+    }
+    uint32_t header[4] = { BinaryMagic, BinaryVersion, format, (uint32_t)identity.size() };
+    bool written = (fwrite(header, sizeof(header), 1, f) == 1)
+        && (fwrite(identity.data(), 1, identity.size(), f) == identity.size())
+        && (fwrite(&binary[0], 1, (size_t)length, f) == (size_t)length);
+    fclose(f);
+    // do not leave a truncated binary behind
+    if(!written)
+        remove(filePath.c_str());
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include "QualityGovernor.h"
+#include "RenderState.h"
+
+typedef struct
+{
+    bool perPixelLighting;
+    bool multisampling;
+    float renderScale;
+} QualityLevel;
+
+// from the highest quality to the lowest, cheapest changes first
+static const QualityLevel levels[] =
+{
+    {true, true, 1.0f},
+    {false, true, 1.0f},
+    {false, false, 1.0f},
+    {false, false, 0.75f},
+    {false, false, 0.5f}
+};
+
+// lower the quality above this fraction of the target, raise it below the other
+static const double SlowRatio = 1.1;
+static const double FastRatio = 0.6;
+
+QualityGovernor::QualityGovernor(RenderState *state)
+{
+    m_state = state;
+    m_enabled = false;
+    m_target = 1.0 / 60.0;
+    m_level = DefaultLevel;
+    m_windowTime = 0.0;
+    m_windowFrames = 0;
+    m_average = 0.0;
+    m_fastWindows = 0;
+    m_raiseDelay = MinRaiseDelay;
+    m_windowsSinceRaise = MaxRaiseDelay;
+}
+
+bool QualityGovernor::enabled() const
+{
+    return m_enabled;
+}
+
+void QualityGovernor::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_windowTime = 0.0;
+    m_windowFrames = 0;
+    m_fastWindows = 0;
+    if(!enabled)
+        m_level = DefaultLevel;
+    apply();
+}
+
+double QualityGovernor::targetFrameTime() const
+{
+    return m_target;
+}
+
+void QualityGovernor::setTargetFrameTime(double seconds)
+{
+    m_target = seconds;
+}
+
+int QualityGovernor::level() const
+{
+    return m_level;
+}
+
+int QualityGovernor::levelCount() const
+{
+    return sizeof(levels) / sizeof(QualityLevel);
+}
+
+void QualityGovernor::frameFinished(double frameTime)
+{
+    if(!m_enabled)
+        return;
+    m_windowTime += frameTime;
+    m_windowFrames++;
+    if(m_windowFrames < WindowFrames)
+        return;
+    m_average = m_windowTime / m_windowFrames;
+    m_windowTime = 0.0;
+    m_windowFrames = 0;
+    m_windowsSinceRaise++;
+
+    int level = m_level;
+    if(m_average > (m_target * SlowRatio))
+    {
+        m_fastWindows = 0;
+        if(m_level < (levelCount() - 1))
+        {
+            // the last raise did not hold, wait longer before the next one
+            if(m_windowsSinceRaise <= 2)
+                m_raiseDelay = min(m_raiseDelay * 2, (int)MaxRaiseDelay);
+            m_level++;
+        }
+    }
+    else if(m_average < (m_target * FastRatio))
+    {
+        m_fastWindows++;
+        if((m_fastWindows >= m_raiseDelay) && (m_level > 0))
+        {
+            m_level--;
+            m_fastWindows = 0;
+            m_windowsSinceRaise = 0;
+        }
+    }
+    else
+    {
+        m_fastWindows = 0;
+    }
+    // leave the settings alone until the level changes
+    if(m_level != level)
+        apply();
+}
+
+void QualityGovernor::apply()
+{
+    const QualityLevel &l = levels[m_level];
+    m_state->setPerPixelLighting(l.perPixelLighting);
+    m_state->setMultisampling(l.multisampling);
+    m_state->setRenderScale(l.renderScale);
+}
+
+string QualityGovernor::statusText() const
+{
+    const QualityLevel &l = levels[m_level];
+    stringstream ss;
+    ss << "Quality: " << (levelCount() - m_level) << " / " << levelCount() << " ("
+       << (l.perPixelLighting ? "per-pixel" : "per-vertex")
+       << (l.multisampling ? ", MSAA" : "")
+       << ", scale " << (int)(l.renderScale * 100.0f) << "%)";
+    ss << "\nFrame time: " << fixed << setprecision(1) << (m_average * 1000.0)
+       << " ms, target " << (m_target * 1000.0) << " ms";
+    return ss.str();
+}
@@ -24,6 +24,43 @@
 #include <sstream>
 #include "RenderState.h"
 
+Binding::Binding(double value)
+{
+    this->param = 0;
+    this->factor = 0.0;
+    this->base = value;
+}
+
+Binding::Binding(const float *param, double factor, double base)
+{
+    this->param = param;
+    this->factor = factor;
+    this->base = base;
+}
+
+float Binding::value() const
+{
+    return param ? (base + factor * (*param)) : base;
+}
+
+Binding bind(const float &param, double factor, double base)
+{
+    return Binding(&param, factor, base);
+}
+
+MeshHandle::MeshHandle()
+{
+    index = 0;
+    generation = 0;
+}
+
+bool MeshHandle::isNull() const
+{
+    return generation == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 RenderState::RenderState()
 {
     m_meshOutput = 0;
@@ -62,10 +99,67 @@ Mesh * RenderState::loadMeshFromData(string name, const char *data, size_t size)
 
 void RenderState::freeMeshes()
 {
-    map<string, Mesh *>::iterator it;
-    for(it = m_meshes.begin(); it != m_meshes.end(); it++)
-        delete it->second;
+    // handles which are still held become stale
+    for(uint32_t i = 0; i < m_meshSlots.size(); i++)
+    {
+        if(m_meshSlots[i].mesh)
+            freeMeshSlot(i);
+    }
     m_meshes.clear();
+    m_meshSlotNames.clear();
+}
+
+void RenderState::freeMeshSlot(uint32_t index)
+{
+    MeshSlot &slot = m_meshSlots[index];
+    delete slot.mesh;
+    slot.mesh = 0;
+    slot.refs = 0;
+    if(++slot.generation == 0)
+        slot.generation = 1;
+    m_freeMeshSlots.push_back(index);
+}
+
+MeshHandle RenderState::acquireMesh(const string &name)
+{
+    MeshHandle h;
+    map<string, uint32_t>::const_iterator it = m_meshSlotNames.find(name);
+    if(it != m_meshSlotNames.end())
+    {
+        MeshSlot &slot = m_meshSlots[it->second];
+        slot.refs++;
+        h.index = it->second;
+        h.generation = slot.generation;
+    }
+    return h;
+}
+
+void RenderState::releaseMesh(MeshHandle h)
+{
+    if(!mesh(h))
+        return;
+    if(--m_meshSlots[h.index].refs == 0)
+        freeMeshSlot(h.index);
+}
+
+Mesh * RenderState::mesh(MeshHandle h) const
+{
+    if((h.index < m_meshSlots.size()) && (m_meshSlots[h.index].generation == h.generation))
+        return m_meshSlots[h.index].mesh;
+    return 0;
+}
+
+void RenderState::removeMesh(const string &name)
+{
+    map<string, uint32_t>::iterator it = m_meshSlotNames.find(name);
+    if(it == m_meshSlotNames.end())
+        return;
+    MeshHandle h;
+    h.index = it->second;
+    h.generation = m_meshSlots[h.index].generation;
+    m_meshSlotNames.erase(it);
+    m_meshes.erase(name);
+    releaseMesh(h);
 }
 
 Mesh * RenderState::loadMeshFromGroup(string name, VertexGroup *vg)
@@ -77,7 +171,25 @@ Mesh * RenderState::loadMeshFromGroup(string name, VertexGroup *vg)
         if(m)
         {
             m->addGroup(vg);
+            // the new mesh replaces any mesh with the same name
+            removeMesh(name);
+            uint32_t index;
+            if(m_freeMeshSlots.empty())
+            {
+                MeshSlot slot;
+                slot.generation = 1;
+                index = m_meshSlots.size();
+                m_meshSlots.push_back(slot);
+            }
+            else
+            {
+                index = m_freeMeshSlots.back();
+                m_freeMeshSlots.pop_back();
+            }
+            m_meshSlots[index].mesh = m;
+            m_meshSlots[index].refs = 1;
             m_meshes.insert(pair<string, Mesh *>(name, m));
+            m_meshSlotNames.insert(pair<string, uint32_t>(name, index));
         }
         delete vg;
     }
@@ -98,7 +210,7 @@ uint32_t RenderState::loadTextureFromData(string name, const char *data, size_t
     return texID;
 }
 
-uint32_t RenderState::texture(string name) const
+uint32_t RenderState::texture(const string &name) const
 {
     map<string, uint32_t>::const_iterator it = m_textures.find(name);
     return (it != m_textures.end()) ? it->second : 0;
@@ -124,6 +236,46 @@ void RenderState::toggleProjection()
     m_projection = !m_projection;
 }
 
+bool RenderState::perPixelLighting() const
+{
+    return false;
+}
+
+void RenderState::setPerPixelLighting(bool enabled)
+{
+    (void)enabled;
+}
+
+bool RenderState::multisampling() const
+{
+    return false;
+}
+
+void RenderState::setMultisampling(bool enabled)
+{
+    (void)enabled;
+}
+
+float RenderState::renderScale() const
+{
+    return 1.0f;
+}
+
+void RenderState::setRenderScale(float scale)
+{
+    (void)scale;
+}
+
+int RenderState::frameLatency() const
+{
+    return 1;
+}
+
+void RenderState::setFrameLatency(int frames)
+{
+    (void)frames;
+}
+
 void RenderState::reset()
 {
     m_output = Mesh::RenderToScreen;
@@ -132,7 +284,60 @@ void RenderState::reset()
     m_wireframe = false;
 }
 
-void RenderState::drawMesh(string name)
+RenderState::SubmitMode RenderState::submitMode() const
+{
+    return Immediate;
+}
+
+void RenderState::setSubmitMode(SubmitMode mode)
+{
+    (void)mode;
+}
+
+string RenderState::frameStatistics() const
+{
+    return string();
+}
+
+void RenderState::registerMaterial(const Material &m)
+{
+    (void)m;
+}
+
+void RenderState::pushName(int name)
+{
+    (void)name;
+}
+
+void RenderState::popName()
+{
+}
+
+matrix4 RenderState::projectionMatrix() const
+{
+    matrix4 m;
+    m.setIdentity();
+    return m;
+}
+
+void RenderState::translateAnimated(const Binding &dx, const Binding &dy, const Binding &dz)
+{
+    translate(dx.value(), dy.value(), dz.value());
+}
+
+void RenderState::rotateAnimated(const Binding &angle, float rx, float ry, float rz)
+{
+    rotate(angle.value(), rx, ry, rz);
+}
+
+void RenderState::drawMesh(MeshHandle h)
+{
+    Mesh *m = mesh(h);
+    if(m)
+        drawMesh(m);
+}
+
+void RenderState::drawMesh(const string &name)
 {
     map<string, Mesh *>::iterator it = m_meshes.find(name);
     if(it != m_meshes.end())
@@ -176,6 +381,16 @@ StateObject::StateObject(RenderState *s)
     m_state = s;
 }
 
+RenderState * StateObject::state() const
+{
+    return m_state;
+}
+
+void StateObject::setState(RenderState *s)
+{
+    m_state = s;
+}
+
 void StateObject::loadIdentity()
 {
     m_state->loadIdentity();
@@ -206,12 +421,27 @@ void StateObject::scale(float sx, float sy, float sz)
     m_state->scale(sx, sy, sz);
 }
 
+void StateObject::translate(const Binding &dx, const Binding &dy, const Binding &dz)
+{
+    m_state->translateAnimated(dx, dy, dz);
+}
+
+void StateObject::rotate(const Binding &angle, float rx, float ry, float rz)
+{
+    m_state->rotateAnimated(angle, rx, ry, rz);
+}
+
 void StateObject::drawMesh(Mesh *m)
 {
     m_state->drawMesh(m);
 }
 
-void StateObject::drawMesh(string name)
+void StateObject::drawMesh(MeshHandle h)
+{
+    m_state->drawMesh(h);
+}
+
+void StateObject::drawMesh(const string &name)
 {
     m_state->drawMesh(name);
 }
@@ -225,3 +455,13 @@ void StateObject::popMaterial()
 {
     m_state->popMaterial();
 }
+
+void StateObject::pushName(int name)
+{
+    m_state->pushName(name);
+}
+
+void StateObject::popName()
+{
+    m_state->popName();
+}
@@ -24,6 +24,9 @@
 #include "Platform.h"
 #include "RenderStateGL1.h"
 #include "MeshGL1.h"
+#ifndef JNI_WRAPPER
+#include "GLTrace.h"
+#endif
 
 RenderStateGL1::RenderStateGL1() : RenderState()
 {
@@ -33,6 +36,15 @@ RenderStateGL1::RenderStateGL1() : RenderState()
     m_light0_pos = vec4(0.0, 1.0, 1.0, 0.0);
 }
 
+RenderStateGL1::~RenderStateGL1()
+{
+#ifndef JNI_WRAPPER
+    map<uint32_t, uint32_t>::iterator it;
+    for(it = m_materialLists.begin(); it != m_materialLists.end(); it++)
+        glDeleteLists(it->second, 1);
+#endif
+}
+
 Mesh * RenderStateGL1::createMesh() const
 {
     return new MeshGL1();
@@ -113,6 +125,13 @@ matrix4 RenderStateGL1::currentMatrix() const
     return m;
 }
 
+matrix4 RenderStateGL1::projectionMatrix() const
+{
+    matrix4 m;
+    glGetFloatv(GL_PROJECTION_MATRIX, (float *)m.d);
+    return m;
+}
+
 void RenderStateGL1::pushMaterial(const Material &m)
 {
     m_materialStack.push_back(m);
@@ -128,8 +147,34 @@ void RenderStateGL1::popMaterial()
         beginApplyMaterial(m_materialStack.back());
 }
 
+void RenderStateGL1::registerMaterial(const Material &m)
+{
+#ifndef JNI_WRAPPER
+    // record the material state in a display list, it is replayed in one call
+    if(m_materialLists.find(m.id()) != m_materialLists.end())
+        return;
+    uint32_t list = glGenLists(1);
+    if(list == 0)
+        return;
+    glNewList(list, GL_COMPILE);
+    beginApplyMaterial(m);
+    glEndList();
+    m_materialLists.insert(pair<uint32_t, uint32_t>(m.id(), list));
+#else
+    (void)m;
+#endif
+}
+
 void RenderStateGL1::beginApplyMaterial(const Material &m)
 {
+#ifndef JNI_WRAPPER
+    map<uint32_t, uint32_t>::iterator it = m_materialLists.find(m.id());
+    if(it != m_materialLists.end())
+    {
+        glCallList(it->second);
+        return;
+    }
+#endif
     glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, (GLfloat *)&m.ambient());
     glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, (GLfloat *)&m.diffuse());
     glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, (GLfloat *)&m.specular());
@@ -152,6 +197,9 @@ void RenderStateGL1::endApplyMaterial(const Material &m)
 
 void RenderStateGL1::beginFrame(int w, int h)
 {
+#ifndef JNI_WRAPPER
+    GLTrace::beginFrame();
+#endif
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_NORMALIZE);
     glShadeModel(GL_SMOOTH);
@@ -184,6 +232,18 @@ void RenderStateGL1::endFrame()
     glDisable(GL_NORMALIZE);
     glDisable(GL_LIGHTING);
     glDisable(GL_LIGHT0);
+#ifndef JNI_WRAPPER
+    GLTrace::endFrame();
+#endif
+}
+
+string RenderStateGL1::frameStatistics() const
+{
+#ifndef JNI_WRAPPER
+    if(GLTrace::enabled())
+        return GLTrace::report();
+#endif
+    return string();
 }
 
 void RenderStateGL1::setupViewport(int w, int h)
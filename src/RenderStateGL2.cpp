@@ -22,9 +22,67 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
 #include "Platform.h"
 #include "RenderStateGL2.h"
+#include "StateCacheGL2.h"
+#include "DrawList.h"
+#include "StreamBufferGL2.h"
+#include "GeometryArenaGL2.h"
+#include "ProgramCacheGL2.h"
 #include "MeshGL2.h"
+#include "GLTrace.h"
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+static const char *uniformNames[] =
+{
+    "u_modelViewMatrix",
+    "u_projectionMatrix",
+    "u_light_ambient",
+    "u_light_diffuse",
+    "u_light_specular",
+    "u_light_pos",
+    "u_material_ambient",
+    "u_material_diffuse",
+    "u_material_specular",
+    "u_material_shine",
+    "u_material_texture"
+};
+
+// std140 layout of the FrameBlock and MaterialBlock uniform blocks
+typedef struct
+{
+    matrix4 projection;
+    vec4 lightAmbient;
+    vec4 lightDiffuse;
+    vec4 lightSpecular;
+    vec4 lightPosition;
+} FrameBlockData;
+
+typedef struct
+{
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    float shine;
+    float padding[3];
+} MaterialBlockData;
+
+// layout of the commands read by glMultiDrawArraysIndirect
+typedef struct
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t first;
+    uint32_t baseInstance;
+} DrawArraysIndirectCommand;
+
+static const char *uniformBlockDefines =
+    "#extension GL_ARB_uniform_buffer_object : require\n"
+    "#define UNIFORM_BLOCKS\n";
 
 RenderStateGL2::RenderStateGL2() : RenderState()
 {
@@ -36,24 +94,84 @@ RenderStateGL2::RenderStateGL2() : RenderState()
     m_diffuse0 = vec4(1.0, 1.0, 1.0, 1.0);
     m_specular0 = vec4(1.0, 1.0, 1.0, 1.0);
     m_light0_pos = vec4(0.0, 1.0, 1.0, 0.0);
-    m_vertexShader = 0;
-    m_pixelShader = 0;
-    m_program = 0;
-    m_modelViewMatrixLoc = -1;
-    m_projMatrixLoc = -1;
-    m_positionAttr = -1;
-    m_normalAttr = -1;
-    m_texCoordsAttr = -1;
+    for(int i = 0; i < VariantCount; i++)
+    {
+        ProgramInfo &p = m_programs[i];
+        p.program = 0;
+        p.vertexShader = 0;
+        p.pixelShader = 0;
+        for(int j = 0; j < UniformCount; j++)
+            p.uniforms[j] = -1;
+        p.attributes = 0;
+        p.frame = 0;
+        p.projection = 0;
+    }
+    m_program = &m_programs[0];
+    m_programCache = new ProgramCacheGL2();
+    m_frame = 1;
+    m_projectionVersion = 1;
+    m_cache = new StateCacheGL2();
+    m_submitMode = Immediate;
+    m_drawList = new DrawList();
+    m_instancing = false;
+    m_perPixelLighting = false;
+    m_multisampling = true;
+    m_renderScale = 1.0f;
+    m_renderTarget = 0;
+    m_renderTargetColor = 0;
+    m_renderTargetDepth = 0;
+    m_renderTargetWidth = 0;
+    m_renderTargetHeight = 0;
+    m_scaled = false;
+    m_renderTargetFailed = false;
+    m_upscaleProgram = 0;
+    m_upscaleVertexShader = 0;
+    m_upscalePixelShader = 0;
+    m_upscaleBuffer = 0;
+    m_frameWidth = 0;
+    m_frameHeight = 0;
+    m_frameLatency = 2;
+    for(int i = 0; i < MaxFrameLatency; i++)
+    {
+        m_frameFences[i] = 0;
+        m_fencedFrames[i] = 0;
+    }
+    m_depthTestEnabled = false;
+    m_multisampleEnabled = true;
+    m_instanceStream = new StreamBufferGL2(m_cache);
+    m_indirect = false;
+    m_indirectStream = new StreamBufferGL2(m_cache);
+    m_arena = new GeometryArenaGL2(m_cache, PositionAttr, NormalAttr,
+                                   TexCoordsAttr, ModelViewAttr);
+    m_batches = 0;
+    m_uniformBlocks = false;
+    m_frameBuffer = 0;
+    m_frameBufferFrame = 0;
+    m_frameBufferProjection = 0;
+    m_materialBuffer = 0;
+    m_materialStride = 0;
+    m_materialCapacity = 0;
 }
 
 RenderStateGL2::~RenderStateGL2()
 {
-    if(m_vertexShader != 0)
-        glDeleteShader(m_vertexShader);
-    if(m_pixelShader != 0)
-        glDeleteShader(m_pixelShader);
-    if(m_program != 0)
-        glDeleteProgram(m_program);
+    // meshes release their geometry through the cache and the arena
+    freeMeshes();
+    freeShaders();
+    freeRenderTarget();
+    releaseFences();
+    if(m_frameBuffer != 0)
+        glDeleteBuffers(1, &m_frameBuffer);
+    if(m_materialBuffer != 0)
+        glDeleteBuffers(1, &m_materialBuffer);
+    if(m_upscaleBuffer != 0)
+        m_cache->deleteBuffer(m_upscaleBuffer);
+    delete m_instanceStream;
+    delete m_indirectStream;
+    delete m_arena;
+    delete m_drawList;
+    delete m_cache;
+    delete m_programCache;
 }
 
 Mesh * RenderStateGL2::createMesh() const
@@ -65,20 +183,34 @@ void RenderStateGL2::drawMesh(Mesh *m)
 {
     if(!m)
         return;
-    glUniformMatrix4fv(m_modelViewMatrixLoc, 1, GL_FALSE,
-                       (const GLfloat *)m_matrix[(int)ModelView].d);
-    glUniformMatrix4fv(m_projMatrixLoc, 1, GL_FALSE,
-                       (const GLfloat *)m_matrix[(int)Projection].d);
+    const matrix4 &modelView = m_matrix[(int)ModelView];
+    const Material &mat = (m_materialStack.size() > 0)
+        ? m_materialStack.back() : m_defaultMaterial;
+    if((m_submitMode != Immediate) && (m_output == Mesh::RenderToScreen))
+    {
+        m_drawList->add(m, modelView, m_drawList->addMaterial(mat), programVariant(mat));
+        return;
+    }
+    useProgram(programVariant(mat));
+    if(m_materialStack.size() > 0)
+        applyMaterial(m_materialStack.back());
+    drawMeshNow(m, modelView);
+}
+
+void RenderStateGL2::drawMeshNow(Mesh *m, const matrix4 &modelView)
+{
+    setUniformValue(ModelViewMatrix, modelView);
     m->draw(m_output, this, m_meshOutput);
     if(m_drawNormals)
         m->drawNormals(this);
+    m_batches++;
 }
 
 void RenderStateGL2::freeTextures()
 {
     map<string, uint32_t>::iterator it;
     for(it = m_textures.begin(); it != m_textures.end(); it++)
-        glDeleteTextures(1, &it->second);
+        m_cache->deleteTexture(it->second);
     m_textures.clear();
 }
 
@@ -91,12 +223,16 @@ void RenderStateGL2::loadIdentity()
 {
     int i = (int)m_matrixMode;
     m_matrix[i].setIdentity();
+    if(m_matrixMode == Projection)
+        m_projectionVersion++;
 }
 
 void RenderStateGL2::multiplyMatrix(const matrix4 &m)
 {
     int i = (int)m_matrixMode;
     m_matrix[i] = m_matrix[i] * m;
+    if(m_matrixMode == Projection)
+        m_projectionVersion++;
 }
 
 void RenderStateGL2::pushMatrix()
@@ -110,6 +246,8 @@ void RenderStateGL2::popMatrix()
     int i = (int)m_matrixMode;
     m_matrix[i] = m_matrixStack[i].back();
     m_matrixStack[i].pop_back();
+    if(m_matrixMode == Projection)
+        m_projectionVersion++;
 }
 
 void RenderStateGL2::translate(float dx, float dy, float dz)
@@ -132,71 +270,474 @@ matrix4 RenderStateGL2::currentMatrix() const
     return m_matrix[(int)m_matrixMode];
 }
 
+matrix4 RenderStateGL2::projectionMatrix() const
+{
+    return m_matrix[(int)Projection];
+}
+
 void RenderStateGL2::pushMaterial(const Material &m)
 {
+    // materials are only applied when something is drawn with them
     m_materialStack.push_back(m);
-    beginApplyMaterial(m);
 }
 
 void RenderStateGL2::popMaterial()
 {
-    Material m = m_materialStack.back();
     m_materialStack.pop_back();
-    endApplyMaterial(m);
-    if(m_materialStack.size() > 0)
-        beginApplyMaterial(m_materialStack.back());
 }
 
-void RenderStateGL2::beginApplyMaterial(const Material &m)
+void RenderStateGL2::registerMaterial(const Material &m)
 {
-    setUniformValue("u_material_ambient", m.ambient());
-    setUniformValue("u_material_diffuse", m.diffuse());
-    setUniformValue("u_material_specular", m.specular());
-    setUniformValue("u_material_shine", m.shine());
-    if(m.texture() != 0)
+    if(m_uniformBlocks)
+        materialOffset(m);
+}
+
+uint32_t RenderStateGL2::materialOffset(const Material &m)
+{
+    map<uint32_t, uint32_t>::iterator it = m_materialOffsets.find(m.id());
+    if(it != m_materialOffsets.end())
+        return it->second;
+
+    // build the block once, materials which were not registered are added
+    // the first time they are used
+    uint32_t offset = m_materialOffsets.size() * m_materialStride;
+    m_materialData.resize(offset + m_materialStride);
+    MaterialBlockData *block = (MaterialBlockData *)&m_materialData[offset];
+    block->ambient = m.ambient();
+    block->diffuse = m.diffuse();
+    block->specular = m.specular();
+    block->shine = m.shine();
+    block->padding[0] = block->padding[1] = block->padding[2] = 0.0f;
+    m_materialOffsets.insert(pair<uint32_t, uint32_t>(m.id(), offset));
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+    if(offset < (m_materialCapacity * m_materialStride))
     {
-        glActiveTexture(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, m.texture());
-        setUniformValue("u_material_texture", 0);
-        setUniformValue("u_has_texture", 1);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(MaterialBlockData), block);
     }
     else
     {
-        setUniformValue("u_has_texture", 0);
+        m_materialCapacity = (m_materialCapacity > 0) ? (m_materialCapacity * 2) : 16;
+        glBufferData(GL_UNIFORM_BUFFER, m_materialCapacity * m_materialStride,
+            0, GL_STATIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, m_materialData.size(), &m_materialData[0]);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return offset;
+}
+
+void RenderStateGL2::submitDrawList()
+{
+    m_drawList->sort((m_submitMode == DeferredFrontToBack)
+        ? DrawList::SortFrontToBack : DrawList::SortByState);
+    if(m_indirect)
+    {
+        submitIndirect();
+        return;
+    }
+    else if(m_instancing)
+    {
+        submitInstanced();
+        return;
+    }
+    uint32_t count = m_drawList->size();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const DrawCommand &c = m_drawList->at(i);
+        useProgram(c.program);
+        applyMaterial(m_drawList->material(c.material));
+        drawMeshNow(c.mesh, c.modelView);
+    }
+}
+
+void RenderStateGL2::submitInstanced()
+{
+    // group consecutive commands using the same mesh and material into batches
+    // and write the matrices of every batch at once
+    uint32_t count = m_drawList->size();
+    matrix4 *instances = (matrix4 *)m_instanceStream->map(count * sizeof(matrix4));
+    if(!instances)
+        return;
+    for(uint32_t i = 0; i < count; i++)
+        instances[i] = m_drawList->at(i).modelView;
+    size_t base = m_instanceStream->commit();
+
+    m_cache->bindVertexArray(0);
+    for(int j = 0; j < 4; j++)
+        glVertexAttribDivisorARB(ModelViewAttr + j, 1);
+    uint32_t start = 0;
+    while(start < count)
+    {
+        const DrawCommand &first = m_drawList->at(start);
+        uint32_t end = start + 1;
+        while(end < count)
+        {
+            const DrawCommand &c = m_drawList->at(end);
+            if((c.mesh != first.mesh) || (c.material != first.material))
+                break;
+            end++;
+        }
+        useProgram(first.program | InstancedFeature);
+        applyMaterial(m_drawList->material(first.material));
+        MeshGL2 *mesh = static_cast<MeshGL2 *>(first.mesh);
+        // the instance pointers are part of the vertex array state, so they
+        // have to be set after binding the array the mesh draws with
+        m_arena->bindVertexArray(true);
+        setInstanceAttributes(base + start * sizeof(matrix4));
+        mesh->drawInstances(end - start);
+        m_batches++;
+        start = end;
+    }
+    m_cache->bindVertexArray(0);
+    for(int j = 0; j < 4; j++)
+        glVertexAttribDivisorARB(ModelViewAttr + j, 0);
+    m_instanceStream->fence();
+}
+
+void RenderStateGL2::submitIndirect()
+{
+    uint32_t count = m_drawList->size();
+    matrix4 *instances = (matrix4 *)m_instanceStream->map(count * sizeof(matrix4));
+    if(!instances)
+        return;
+    for(uint32_t i = 0; i < count; i++)
+        instances[i] = m_drawList->at(i).modelView;
+    size_t base = m_instanceStream->commit();
+
+    // every group of a batch becomes an indirect command whose base instance
+    // selects the matrices of the batch, commands using the same material are
+    // drawn together.
+    m_runs.clear();
+    m_indirectData.clear();
+    uint32_t start = 0;
+    while(start < count)
+    {
+        const DrawCommand &first = m_drawList->at(start);
+        uint32_t end = start + 1;
+        while(end < count)
+        {
+            const DrawCommand &c = m_drawList->at(end);
+            if((c.mesh != first.mesh) || (c.material != first.material))
+                break;
+            end++;
+        }
+        MeshGL2 *mesh = static_cast<MeshGL2 *>(first.mesh);
+        for(int i = 0; i < mesh->groupCount(); i++)
+        {
+            uint32_t mode = mesh->groupMode(i);
+            if(m_runs.empty() || (m_runs.back().material != first.material)
+                || (m_runs.back().mode != mode))
+            {
+                uint32_t command = m_indirectData.size() / 4;
+                MaterialRun r = { first.material, first.program | InstancedFeature,
+                                  mode, command, 0 };
+                m_runs.push_back(r);
+            }
+            m_runs.back().count++;
+            m_indirectData.push_back(mesh->groupSize(i));
+            m_indirectData.push_back(end - start);
+            m_indirectData.push_back(mesh->groupFirst(i));
+            m_indirectData.push_back(start);
+        }
+        start = end;
     }
+    size_t commands = 0;
+    if(m_indirectData.size() > 0)
+    {
+        size_t size = m_indirectData.size() * sizeof(uint32_t);
+        void *data = m_indirectStream->map(size);
+        if(!data)
+            return;
+        memcpy(data, &m_indirectData[0], size);
+        commands = m_indirectStream->commit();
+    }
+
+    // every variant reads the same attributes
+    useProgram(m_runs.empty() ? InstancedFeature : m_runs[0].program);
+    m_cache->bindVertexArray(0);
+    for(int j = 0; j < 4; j++)
+        glVertexAttribDivisorARB(ModelViewAttr + j, 1);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectStream->buffer());
+    if(!m_arena->bindVertexArray(true))
+    {
+        m_cache->enableAttributes(attributeMask());
+        m_arena->setAttributes();
+    }
+    setInstanceAttributes(base);
+    for(uint32_t i = 0; i < m_runs.size(); i++)
+    {
+        const MaterialRun &r = m_runs[i];
+        useProgram(r.program);
+        applyMaterial(m_drawList->material(r.material));
+        size_t offset = commands + r.start * sizeof(DrawArraysIndirectCommand);
+        glMultiDrawArraysIndirect(r.mode, BUFFER_OFFSET(offset), r.count, 0);
+        m_batches++;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    m_cache->bindVertexArray(0);
+    for(int j = 0; j < 4; j++)
+        glVertexAttribDivisorARB(ModelViewAttr + j, 0);
+    m_instanceStream->fence();
+    m_indirectStream->fence();
 }
 
-void RenderStateGL2::endApplyMaterial(const Material &m)
+void RenderStateGL2::setInstanceAttributes(size_t offset)
 {
+    m_cache->bindBuffer(GL_ARRAY_BUFFER, m_instanceStream->buffer());
+    for(int j = 0; j < 4; j++)
+    {
+        glVertexAttribPointer(ModelViewAttr + j, 4, GL_FLOAT, GL_FALSE,
+            sizeof(matrix4), BUFFER_OFFSET(offset + j * sizeof(vec4)));
+    }
+}
+
+void RenderStateGL2::applyMaterial(const Material &m)
+{
+    if(!m_cache->setMaterial(m.id()))
+        return;
+    if(m_uniformBlocks)
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, MaterialBlock, m_materialBuffer,
+            materialOffset(m), sizeof(MaterialBlockData));
+        if(m.texture() != 0)
+        {
+            m_cache->activeTexture(0);
+            m_cache->bindTexture(GL_TEXTURE_2D, m.texture());
+        }
+        return;
+    }
+    setUniformValue(MaterialAmbient, m.ambient());
+    setUniformValue(MaterialDiffuse, m.diffuse());
+    setUniformValue(MaterialSpecular, m.specular());
+    setUniformValue(MaterialShine, m.shine());
     if(m.texture() != 0)
-        glBindTexture(GL_TEXTURE_2D, 0);
+    {
+        m_cache->activeTexture(0);
+        m_cache->bindTexture(GL_TEXTURE_2D, m.texture());
+    }
+}
+
+uint32_t RenderStateGL2::programVariant(const Material &m) const
+{
+    uint32_t variant = 0;
+    if(m.texture() != 0)
+        variant |= TexturedFeature;
+    if(m_perPixelLighting)
+        variant |= PerPixelFeature;
+    return variant;
+}
+
+void RenderStateGL2::useProgram(uint32_t variant)
+{
+    ProgramInfo *p = &m_programs[variant];
+    m_program = p;
+    m_cache->useProgram(p->program);
+    if(m_uniformBlocks)
+    {
+        // the frame block is shared by every program
+        if((m_frameBufferFrame != m_frame) || (m_frameBufferProjection != m_projectionVersion))
+            updateFrameBlock();
+        return;
+    }
+    // uniforms are per-program state, update the ones which changed since
+    // the program was last used
+    if(p->frame != m_frame)
+    {
+        setUniformValue(LightAmbient, m_ambient0);
+        setUniformValue(LightDiffuse, m_diffuse0);
+        setUniformValue(LightSpecular, m_specular0);
+        setUniformValue(LightPosition, m_light0_pos);
+        setUniformValue(MaterialTexture, 0);
+        p->frame = m_frame;
+    }
+    if(p->projection != m_projectionVersion)
+    {
+        setUniformValue(ProjectionMatrix, m_matrix[(int)Projection]);
+        p->projection = m_projectionVersion;
+    }
+}
+
+void RenderStateGL2::updateFrameBlock()
+{
+    FrameBlockData block;
+    block.projection = m_matrix[(int)Projection];
+    block.lightAmbient = m_ambient0;
+    block.lightDiffuse = m_diffuse0;
+    block.lightSpecular = m_specular0;
+    block.lightPosition = m_light0_pos;
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlockData), &block, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameBlock, m_frameBuffer);
+    m_frameBufferFrame = m_frame;
+    m_frameBufferProjection = m_projectionVersion;
 }
 
 void RenderStateGL2::beginFrame(int w, int h)
 {
-    glPushAttrib(GL_ENABLE_BIT);
-    glUseProgram(m_program);
-    initShaders();
+    GLTrace::beginFrame();
+    m_frame++;
+    // keep the CPU at most a few frames ahead of the GPU
+    waitFrames(m_frame);
+    // Qt may have used the context since the last frame
+    m_cache->invalidate();
+    m_cache->clearStats();
+    m_batches = 0;
+    m_depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+    m_multisampleEnabled = glIsEnabled(GL_MULTISAMPLE);
     glEnable(GL_DEPTH_TEST);
-    setUniformValue("u_light_ambient", m_ambient0);
-    setUniformValue("u_light_diffuse", m_diffuse0);
-    setUniformValue("u_light_specular", m_specular0);
-    setUniformValue("u_light_pos", m_light0_pos);
+    if(!m_multisampling)
+        glDisable(GL_MULTISAMPLE);
+    m_frameWidth = w;
+    m_frameHeight = h;
+    m_scaled = false;
+    if(m_renderScale < 1.0f)
+    {
+        int sw = max((int)(w * m_renderScale + 0.5f), 1);
+        int sh = max((int)(h * m_renderScale + 0.5f), 1);
+        m_scaled = bindRenderTarget(sw, sh);
+        if(m_scaled)
+        {
+            w = sw;
+            h = sh;
+        }
+    }
     setupViewport(w, h);
     setMatrixMode(ModelView);
     pushMatrix();
     loadIdentity();
     glClearColor(m_bgColor.x, m_bgColor.y, m_bgColor.z, m_bgColor.w);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    m_drawList->clear();
 }
 
 void RenderStateGL2::endFrame()
 {
+    if(m_drawList->size() > 0)
+        submitDrawList();
+    if(m_scaled)
+        drawRenderTarget();
+    fenceFrame(m_frame);
     glFlush();
     setMatrixMode(ModelView);
     popMatrix();
-    glUseProgram(0);
-    glPopAttrib();
+    m_cache->reset();
+    // only restore what was changed, without the attribute stack
+    if(!m_depthTestEnabled)
+        glDisable(GL_DEPTH_TEST);
+    if(m_multisampleEnabled && !m_multisampling)
+        glEnable(GL_MULTISAMPLE);
+    GLTrace::endFrame();
+}
+
+void RenderStateGL2::waitFrames(uint32_t frame)
+{
+    // wait for the frames which are more than the latency behind
+    for(int i = 0; i < MaxFrameLatency; i++)
+    {
+        GLsync sync = (GLsync)m_frameFences[i];
+        if(!sync || ((m_fencedFrames[i] + m_frameLatency) > frame))
+            continue;
+        GLenum result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        while(result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(sync, 0, 1000000000);
+        glDeleteSync(sync);
+        m_frameFences[i] = 0;
+    }
+}
+
+void RenderStateGL2::fenceFrame(uint32_t frame)
+{
+    if(!GLEW_ARB_sync)
+        return;
+    int slot = frame % MaxFrameLatency;
+    if(m_frameFences[slot])
+        glDeleteSync((GLsync)m_frameFences[slot]);
+    m_frameFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_fencedFrames[slot] = frame;
+}
+
+void RenderStateGL2::releaseFences()
+{
+    for(int i = 0; i < MaxFrameLatency; i++)
+    {
+        if(m_frameFences[i])
+            glDeleteSync((GLsync)m_frameFences[i]);
+        m_frameFences[i] = 0;
+    }
+}
+
+bool RenderStateGL2::bindRenderTarget(int width, int height)
+{
+    if(!GLEW_ARB_framebuffer_object)
+        return false;
+    if((m_renderTarget != 0) && (m_renderTargetWidth == width)
+        && (m_renderTargetHeight == height))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_renderTarget);
+        return true;
+    }
+    freeRenderTarget();
+    glGenFramebuffers(1, &m_renderTarget);
+    glGenTextures(1, &m_renderTargetColor);
+    glGenRenderbuffers(1, &m_renderTargetDepth);
+    m_cache->activeTexture(0);
+    m_cache->bindTexture(GL_TEXTURE_2D, m_renderTargetColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    m_cache->bindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_renderTargetDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_renderTarget);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, m_renderTargetColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+        GL_RENDERBUFFER, m_renderTargetDepth);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        freeRenderTarget();
+        // do not try again every frame, whoever sets the scale
+        m_renderTargetFailed = true;
+        m_renderScale = 1.0f;
+        return false;
+    }
+    m_renderTargetWidth = width;
+    m_renderTargetHeight = height;
+    return true;
+}
+
+void RenderStateGL2::freeRenderTarget()
+{
+    if(m_renderTarget != 0)
+        glDeleteFramebuffers(1, &m_renderTarget);
+    if(m_renderTargetColor != 0)
+        m_cache->deleteTexture(m_renderTargetColor);
+    if(m_renderTargetDepth != 0)
+        glDeleteRenderbuffers(1, &m_renderTargetDepth);
+    m_renderTarget = m_renderTargetColor = m_renderTargetDepth = 0;
+    m_renderTargetWidth = m_renderTargetHeight = 0;
+}
+
+void RenderStateGL2::drawRenderTarget()
+{
+    // the default framebuffer may have sample buffers, which cannot be
+    // blitted to, so the scene is upscaled by drawing it on a quad
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_frameWidth, m_frameHeight);
+    glDisable(GL_DEPTH_TEST);
+    m_cache->useProgram(m_upscaleProgram);
+    m_cache->activeTexture(0);
+    m_cache->bindTexture(GL_TEXTURE_2D, m_renderTargetColor);
+    m_cache->bindBuffer(GL_ARRAY_BUFFER, m_upscaleBuffer);
+    m_cache->enableAttributes(1 << PositionAttr);
+    glVertexAttribPointer(PositionAttr, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glEnable(GL_DEPTH_TEST);
 }
 
 void RenderStateGL2::setupViewport(int w, int h)
@@ -217,31 +758,126 @@ void RenderStateGL2::setupViewport(int w, int h)
 void RenderStateGL2::init()
 {
     loadShaders();
+    m_arena->setUseVertexArrays(GLEW_ARB_vertex_array_object);
+}
+
+RenderState::SubmitMode RenderStateGL2::submitMode() const
+{
+    return m_submitMode;
 }
 
-int RenderStateGL2::positionAttr() const
+void RenderStateGL2::setSubmitMode(SubmitMode mode)
 {
-    return m_positionAttr;
+    m_submitMode = mode;
 }
 
-int RenderStateGL2::normalAttr() const
+string RenderStateGL2::frameStatistics() const
 {
-    return m_normalAttr;
+    stringstream ss;
+    ss << m_cache->statsText();
+    if(m_submitMode != Immediate)
+    {
+        ss << "\nDraw list: " << m_drawList->size() << " commands, "
+           << m_drawList->materialCount() << " materials";
+    }
+    ss << "\nGeometry: " << m_arena->used() << " / " << m_arena->capacity() << " vertices";
+    if(m_scaled)
+        ss << "\nRender scale: " << m_renderTargetWidth << "x" << m_renderTargetHeight;
+    ss << "\nDraw calls: " << m_batches;
+    if(m_instancing && (m_submitMode != Immediate))
+    {
+        ss << (m_indirect ? " (indirect" : " (instanced");
+        if(m_instanceStream->persistent())
+            ss << ", persistent buffer";
+        ss << ")";
+    }
+    if(GLEW_ARB_sync)
+        ss << "\nFrame latency: " << m_frameLatency << " frames";
+    if(GLTrace::enabled())
+        ss << "\n" << GLTrace::report();
+    return ss.str();
 }
 
-int RenderStateGL2::texCoordsAttr() const
+StateCacheGL2 * RenderStateGL2::cache() const
 {
-    return m_texCoordsAttr;
+    return m_cache;
 }
 
-uint32_t RenderStateGL2::loadShader(string path, uint32_t type) const
+GeometryArenaGL2 * RenderStateGL2::arena() const
+{
+    return m_arena;
+}
+
+bool RenderStateGL2::instancing() const
+{
+    return m_instancing;
+}
+
+bool RenderStateGL2::indirect() const
+{
+    return m_indirect;
+}
+
+bool RenderStateGL2::uniformBlocks() const
+{
+    return m_uniformBlocks;
+}
+
+bool RenderStateGL2::perPixelLighting() const
+{
+    return m_perPixelLighting;
+}
+
+void RenderStateGL2::setPerPixelLighting(bool enabled)
+{
+    m_perPixelLighting = enabled;
+}
+
+bool RenderStateGL2::multisampling() const
+{
+    return m_multisampling;
+}
+
+void RenderStateGL2::setMultisampling(bool enabled)
+{
+    m_multisampling = enabled;
+}
+
+float RenderStateGL2::renderScale() const
+{
+    return m_renderScale;
+}
+
+void RenderStateGL2::setRenderScale(float scale)
+{
+    m_renderScale = m_renderTargetFailed ? 1.0f : min(max(scale, 0.25f), 1.0f);
+}
+
+int RenderStateGL2::frameLatency() const
+{
+    return m_frameLatency;
+}
+
+void RenderStateGL2::setFrameLatency(int frames)
+{
+    m_frameLatency = min(max(frames, 1), (int)MaxFrameLatency);
+}
+
+void RenderStateGL2::setProgramCacheDir(string dir)
+{
+    m_programCache->setDirectory(dir);
+}
+
+uint32_t RenderStateGL2::attributeMask() const
+{
+    return m_program->attributes;
+}
+
+uint32_t RenderStateGL2::loadShader(const string &code, uint32_t type, string defines) const
 {
-    char *code = loadFileData(path);
-    if(!code)
-        return 0;
     uint32_t shader = glCreateShader(type);
-    glShaderSource(shader, 1, (const GLchar **)&code, 0);
-    freeFileData(code);
+    const GLchar *sources[2] = { defines.c_str(), code.c_str() };
+    glShaderSource(shader, 2, sources, 0);
     glCompileShader(shader);
     GLint status;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
@@ -260,32 +896,41 @@ uint32_t RenderStateGL2::loadShader(string path, uint32_t type) const
         {
             fprintf(stderr, "Error compiling shader.\n");
         }
+        glDeleteShader(shader);
         return 0;
     }
     return shader;
 }
 
-bool RenderStateGL2::loadShaders()
+uint32_t RenderStateGL2::linkProgram(const string &vertexCode, const string &pixelCode,
+                                     string defines, uint32_t &vertexShader,
+                                     uint32_t &pixelShader) const
 {
-    //TODO fallback to GL1 when in a pinch
-    uint32_t vertexShader = loadShader("vertex.glsl", GL_VERTEX_SHADER);
+    vertexShader = loadShader(vertexCode, GL_VERTEX_SHADER, defines);
     if(vertexShader == 0)
-        return false;
-    uint32_t pixelShader = loadShader("fragment.glsl", GL_FRAGMENT_SHADER);
+        return 0;
+    pixelShader = loadShader(pixelCode, GL_FRAGMENT_SHADER, defines);
     if(pixelShader == 0)
     {
         glDeleteShader(vertexShader);
-        return false;
+        return 0;
     }
     uint32_t program = glCreateProgram();
     if(program == 0)
     {
         glDeleteShader(vertexShader);
         glDeleteShader(pixelShader);
-        return false;
+        return 0;
     }
     glAttachShader(program, vertexShader);
     glAttachShader(program, pixelShader);
+    // use the same attribute locations in every program
+    glBindAttribLocation(program, PositionAttr, "a_position");
+    glBindAttribLocation(program, NormalAttr, "a_normal");
+    glBindAttribLocation(program, TexCoordsAttr, "a_texCoords");
+    glBindAttribLocation(program, ModelViewAttr, "a_modelViewMatrix");
+    if(m_programCache->enabled())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(program);
     GLint status;
     glGetProgramiv(program, GL_LINK_STATUS, &status);
@@ -309,35 +954,164 @@ bool RenderStateGL2::loadShaders()
         glDeleteShader(pixelShader);
         return 0;
     }
-    m_program = program;
-    m_vertexShader = vertexShader;
-    m_pixelShader = pixelShader;
-    m_modelViewMatrixLoc = glGetUniformLocation(program, "u_modelViewMatrix");
-    m_projMatrixLoc = glGetUniformLocation(program, "u_projectionMatrix");
-    m_positionAttr = glGetAttribLocation(program, "a_position");
-    m_normalAttr = glGetAttribLocation(program, "a_normal");
-    m_texCoordsAttr = glGetAttribLocation(program, "a_texCoords");
+    return program;
+}
+
+bool RenderStateGL2::loadProgram(uint32_t variant, string defines)
+{
+    if(variant & TexturedFeature)
+        defines += "#define TEXTURED\n";
+    if(variant & PerPixelFeature)
+        defines += "#define PER_PIXEL_LIGHTING\n";
+    if(variant & InstancedFeature)
+        defines += "#define INSTANCED\n";
+    string vertexCode, pixelCode;
+    if(!loadFileBlob("vertex.glsl", vertexCode) || !loadFileBlob("fragment.glsl", pixelCode))
+        return false;
+    // only compile the program if no usable binary was cached
+    string source = defines + '\0' + vertexCode + '\0' + pixelCode;
+    uint32_t vertexShader = 0, pixelShader = 0;
+    uint32_t program = m_programCache->load(source);
+    if(program == 0)
+    {
+        program = linkProgram(vertexCode, pixelCode, defines, vertexShader, pixelShader);
+        if(program == 0)
+            return false;
+        m_programCache->store(program, source);
+    }
+    ProgramInfo &p = m_programs[variant];
+    p.program = program;
+    p.vertexShader = vertexShader;
+    p.pixelShader = pixelShader;
+    for(int i = 0; i < UniformCount; i++)
+        p.uniforms[i] = glGetUniformLocation(program, uniformNames[i]);
+    if(m_uniformBlocks)
+    {
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FrameBlock"), FrameBlock);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "MaterialBlock"), MaterialBlock);
+        // samplers cannot be part of a block
+        glUseProgram(program);
+        glUniform1i(p.uniforms[MaterialTexture], 0);
+        glUseProgram(0);
+    }
+    p.attributes = (1 << PositionAttr) | (1 << NormalAttr) | (1 << TexCoordsAttr);
+    if(glGetAttribLocation(program, "a_modelViewMatrix") == ModelViewAttr)
+        p.attributes |= (0xf << ModelViewAttr);
+    p.frame = 0;
+    p.projection = 0;
+    return true;
+}
+
+bool RenderStateGL2::loadShaders()
+{
+    //TODO fallback to GL1 when in a pinch
+    string defines;
+    m_uniformBlocks = GLEW_ARB_uniform_buffer_object && loadUniformBuffers();
+    if(m_uniformBlocks)
+    {
+        defines = uniformBlockDefines;
+        if(!loadProgram(0, defines))
+        {
+            // use individual uniforms if the blocks are not supported by GLSL
+            freeShaders();
+            m_uniformBlocks = false;
+            defines = "";
+        }
+    }
+    if(!m_uniformBlocks && !loadProgram(0, defines))
+        return false;
+    for(uint32_t i = 1; i < InstancedFeature; i++)
+    {
+        if(!loadProgram(i, defines))
+            return false;
+    }
+    m_instancing = GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+    for(uint32_t i = InstancedFeature; m_instancing && (i < VariantCount); i++)
+        m_instancing = loadProgram(i, defines);
+    // the base instance of indirect commands must be zero without ARB_base_instance
+    m_indirect = m_instancing && GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+    m_renderTargetFailed = !GLEW_ARB_framebuffer_object || !loadUpscaleProgram();
+    if(m_renderTargetFailed)
+        m_renderScale = 1.0f;
     return true;
 }
 
-void RenderStateGL2::initShaders()
+bool RenderStateGL2::loadUpscaleProgram()
+{
+    string vertexCode, pixelCode;
+    if(!loadFileBlob("upscale_vertex.glsl", vertexCode)
+        || !loadFileBlob("upscale_fragment.glsl", pixelCode))
+        return false;
+    m_upscaleProgram = linkProgram(vertexCode, pixelCode, "",
+        m_upscaleVertexShader, m_upscalePixelShader);
+    if(m_upscaleProgram == 0)
+        return false;
+    glUseProgram(m_upscaleProgram);
+    glUniform1i(glGetUniformLocation(m_upscaleProgram, "u_texture"), 0);
+    glUseProgram(0);
+    // one triangle strip over the viewport
+    const GLfloat quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    glGenBuffers(1, &m_upscaleBuffer);
+    m_cache->bindBuffer(GL_ARRAY_BUFFER, m_upscaleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    m_cache->bindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+bool RenderStateGL2::loadUniformBuffers()
+{
+    // material blocks are bound at offsets which must be aligned
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment <= 0)
+        return false;
+    m_materialStride = sizeof(MaterialBlockData);
+    m_materialStride = ((m_materialStride + alignment - 1) / alignment) * alignment;
+    if(m_frameBuffer == 0)
+        glGenBuffers(1, &m_frameBuffer);
+    if(m_materialBuffer == 0)
+        glGenBuffers(1, &m_materialBuffer);
+    return true;
+}
+
+void RenderStateGL2::freeShaders()
+{
+    for(int i = 0; i < VariantCount; i++)
+    {
+        ProgramInfo &p = m_programs[i];
+        if(p.vertexShader != 0)
+            glDeleteShader(p.vertexShader);
+        if(p.pixelShader != 0)
+            glDeleteShader(p.pixelShader);
+        if(p.program != 0)
+            glDeleteProgram(p.program);
+        p.program = p.vertexShader = p.pixelShader = 0;
+    }
+    if(m_upscaleVertexShader != 0)
+        glDeleteShader(m_upscaleVertexShader);
+    if(m_upscalePixelShader != 0)
+        glDeleteShader(m_upscalePixelShader);
+    if(m_upscaleProgram != 0)
+        glDeleteProgram(m_upscaleProgram);
+    m_upscaleProgram = m_upscaleVertexShader = m_upscalePixelShader = 0;
+}
+
+void RenderStateGL2::setUniformValue(Uniform u, const vec4 &v)
 {
+    glUniform4fv(m_program->uniforms[u], 1, (GLfloat *)&v);
 }
 
-void RenderStateGL2::setUniformValue(string name, const vec4 &v)
+void RenderStateGL2::setUniformValue(Uniform u, float f)
 {
-    int location = glGetUniformLocation(m_program, name.c_str());
-    glUniform4fv(location, 1, (GLfloat *)&v);
+    glUniform1f(m_program->uniforms[u], f);
 }
 
-void RenderStateGL2::setUniformValue(string name, float f)
+void RenderStateGL2::setUniformValue(Uniform u, int i)
 {
-    int location = glGetUniformLocation(m_program, name.c_str());
-    glUniform1f(location, f);
+    glUniform1i(m_program->uniforms[u], i);
 }
 
-void RenderStateGL2::setUniformValue(string name, int i)
+void RenderStateGL2::setUniformValue(Uniform u, const matrix4 &m)
 {
-    int location = glGetUniformLocation(m_program, name.c_str());
-    glUniform1i(location, i);
+    glUniformMatrix4fv(m_program->uniforms[u], 1, GL_FALSE, (const GLfloat *)m.d);
 }
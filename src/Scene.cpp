@@ -23,10 +23,17 @@
 
 #include <cmath>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 #include "Scene.h"
 #include "Dragon.h"
 #include "Mesh.h"
 #include "Material.h"
+#include "DrawRecorder.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "SceneGraph.h"
+#include "JobSystem.h"
 
 static Material debugMaterial(vec4(0.2, 0.2, 0.2, 1.0),
     vec4(1.0, 4.0/6.0, 0.0, 1.0), vec4(0.2, 0.2, 0.2, 1.0), 20.0);
@@ -34,47 +41,135 @@ static Material debugMaterial(vec4(0.2, 0.2, 0.2, 1.0),
 static Material floorMaterial(vec4(0.5, 0.5, 0.5, 1.0),
     vec4(1.0, 1.0, 1.0, 1.0), vec4(0.0, 0.0, 0.0, 1.0), 00.0);
 
+// mesh of the scene, loaded by a job
+typedef struct
+{
+    const char *name;
+    const char *path;
+    VertexGroup *group;
+} MeshFile;
+
 static double currentTime();
+static uint32_t crowdRandom(uint32_t &seed);
+static float crowdUniform(uint32_t &seed, float low, float high);
+static bool sameMatrix(const matrix4 &a, const matrix4 &b);
+static double flyingCurve(double t);
+static double jumpingCurve(double t);
+
+static const AnimationCurve::Source sceneCurves[] =
+{
+    {"flying", flyingCurve, 4.0 * M_PI, 16, 1e-5},
+    {"jumping", jumpingCurve, 2.0 * M_PI, 16, 1e-5}
+};
+static void loadMeshTask(void *arg, int index);
+
+static const char *meshNames[] =
+{
+    "floor",
+    "letter_p",
+    "letter_a",
+    "letter_s",
+    "dragon_chest"
+};
+
+static const char *scaleTextures[] =
+{
+    "scale_green",
+    "scale_black",
+    "scale_bronze",
+    "scale_gold"
+};
 
-Scene::Scene(RenderState *state) : StateObject(state)
+Scene::Scene(RenderState *state, int crowdSize) : StateObject(state)
 {
     m_camera = Camera_Static;
     m_exportQueued = false;
+    m_preparing = false;
+    m_prepared = false;
     m_sigma = 1.0;
     m_loaded = false;
 
     m_debugDragon = new Dragon(Dragon::Floating, m_state);
     m_debugDragon->scalesMaterial() = debugMaterial;
     m_debugDragon->wingMaterial() = debugMaterial;
-    m_dragons.push_back(new Dragon(Dragon::Floating, m_state));
-    m_dragons.push_back(new Dragon(Dragon::Flying, m_state));
-    m_dragons.push_back(new Dragon(Dragon::Jumping, m_state));
+    m_poses = new DragonPoses((crowdSize > 0) ? crowdSize : 3);
+    m_flyingCurve.bake(sceneCurves[0]);
+    m_jumpingCurve.bake(sceneCurves[1]);
+    if(crowdSize > 0)
+    {
+        spawnCrowd(crowdSize);
+    }
+    else
+    {
+        m_dragons.push_back(new Dragon(Dragon::Floating, m_state, m_poses));
+        m_dragons.push_back(new Dragon(Dragon::Flying, m_state, m_poses));
+        m_dragons.push_back(new Dragon(Dragon::Jumping, m_state, m_poses));
+    }
+    m_jobs = JobSystem::shared();
+    m_retained = true;
+    m_culling = true;
+    m_occlusion = true;
+    m_occlusionCuller = new OcclusionCuller(160, 96);
+    m_exporting = false;
+    m_meshesOutside = 0;
+    m_meshesOccluded = 0;
+    m_viewChanged = true;
+    m_preparedUpdates = 0;
+    m_cullOutside = 0;
+    m_cullOccluded = 0;
+    m_nodesUpdated = 0;
+    m_treeSpheres = 0;
+    m_treeBuilds = 0;
+    m_occluderTriangles = 0;
+    m_animationTime = 0.0;
+    m_drawTime = 0.0;
+    m_lastPick.item = SCENE;
+    m_lastPick.dragon = -1;
+    m_lastPick.distance = 0.0;
+    m_pickTime = -1.0;
     reset();
     animate();
 }
 
 Scene::~Scene()
 {
+    discardPrepared();
+    for(size_t i = 0; i < m_recorders.size(); i++)
+        delete m_recorders[i];
+    m_recorders.clear();
+    freeNodes();
+    delete m_occlusionCuller;
+    for(int i = 0; i < MeshCount; i++)
+        m_state->releaseMesh(m_meshes[i]);
     delete m_debugDragon;
     vector<Dragon *>::iterator it;
     for(it = m_dragons.begin(); it != m_dragons.end(); it++)
         delete *it;
     m_dragons.clear();
+    delete m_poses;
 }
 
 void Scene::init()
 {
-    if(m_dragons.size() < 3)
+    if(m_dragons.empty())
         return;
-    m_state->loadMeshFromFile("floor", "meshes/floor.obj");
-    m_state->loadMeshFromFile("letter_p", "meshes/LETTER_P.obj");
-    m_state->loadMeshFromFile("letter_a", "meshes/LETTER_A.obj");
-    m_state->loadMeshFromFile("letter_s", "meshes/LETTER_S.obj");
-    m_state->loadMeshFromFile("wing_membrane", "meshes/dragon_wing_membrane.obj");
-    m_state->loadMeshFromFile("joint", "meshes/dragon_joint_spin.obj");
-    m_state->loadMeshFromFile("dragon_chest", "meshes/dragon_chest.obj");
-    m_state->loadMeshFromFile("dragon_head", "meshes/dragon_head.obj");
-    m_state->loadMeshFromFile("dragon_tail_end", "meshes/dragon_tail_end.obj");
+    // parse the files in jobs, then make the meshes here where GL can be used
+    MeshFile meshFiles[] =
+    {
+        {"floor", "meshes/floor.obj", 0},
+        {"letter_p", "meshes/LETTER_P.obj", 0},
+        {"letter_a", "meshes/LETTER_A.obj", 0},
+        {"letter_s", "meshes/LETTER_S.obj", 0},
+        {"wing_membrane", "meshes/dragon_wing_membrane.obj", 0},
+        {"joint", "meshes/dragon_joint_spin.obj", 0},
+        {"dragon_chest", "meshes/dragon_chest.obj", 0},
+        {"dragon_head", "meshes/dragon_head.obj", 0},
+        {"dragon_tail_end", "meshes/dragon_tail_end.obj", 0}
+    };
+    int meshFileCount = sizeof(meshFiles) / sizeof(MeshFile);
+    m_jobs->parallelFor(loadMeshTask, meshFiles, meshFileCount, 1);
+    for(int i = 0; i < meshFileCount; i++)
+        m_state->loadMeshFromGroup(meshFiles[i].name, meshFiles[i].group);
     m_state->loadTextureFromFile("lava_green", "textures/lava_green.tiff", true);
     m_state->loadTextureFromFile("scale_gold", "textures/scale_gold.tiff");
     m_state->loadTextureFromFile("scale_green", "textures/scale_green.tiff");
@@ -84,20 +179,163 @@ void Scene::init()
         return;
     m_loaded = true;
 
-    m_dragons[0]->scalesMaterial().setTexture(m_state->texture("scale_green"));
-    m_dragons[0]->wingMaterial().setTexture(m_state->texture("scale_green"));
-    m_dragons[1]->scalesMaterial().setTexture(m_state->texture("scale_black"));
-    m_dragons[1]->wingMaterial().setTexture(m_state->texture("scale_black"));
-    m_dragons[2]->scalesMaterial().setTexture(m_state->texture("scale_bronze"));
-    m_dragons[2]->wingMaterial().setTexture(m_state->texture("scale_bronze"));
+    if(m_crowd.empty())
+    {
+        m_dragons[0]->scalesMaterial().setTexture(m_state->texture("scale_green"));
+        m_dragons[0]->wingMaterial().setTexture(m_state->texture("scale_green"));
+        m_dragons[1]->scalesMaterial().setTexture(m_state->texture("scale_black"));
+        m_dragons[1]->wingMaterial().setTexture(m_state->texture("scale_black"));
+        m_dragons[2]->scalesMaterial().setTexture(m_state->texture("scale_bronze"));
+        m_dragons[2]->wingMaterial().setTexture(m_state->texture("scale_bronze"));
+    }
+    else
+    {
+        // copies keep the same material ID, so the crowd only uses a few
+        // materials and sorting by state still batches its draw calls
+        Dragon *first = m_dragons[0];
+        Material scales[4], wings[4];
+        for(int i = 0; i < 4; i++)
+        {
+            scales[i] = first->scalesMaterial();
+            scales[i].setTexture(m_state->texture(scaleTextures[i]));
+            wings[i] = first->wingMaterial();
+            wings[i].setTexture(m_state->texture(scaleTextures[i]));
+        }
+        for(size_t i = 0; i < m_dragons.size(); i++)
+        {
+            Dragon *d = m_dragons[i];
+            d->scalesMaterial() = scales[m_crowd[i].variant];
+            d->wingMaterial() = wings[m_crowd[i].variant];
+            d->tongueMaterial() = first->tongueMaterial();
+            d->membraneMaterial() = first->membraneMaterial();
+        }
+    }
     floorMaterial.setTexture(m_state->texture("lava_green"));
+
+    for(int i = 0; i < MeshCount; i++)
+    {
+        m_state->releaseMesh(m_meshes[i]);
+        m_meshes[i] = m_state->acquireMesh(meshNames[i]);
+    }
+    m_state->registerMaterial(debugMaterial);
+    m_state->registerMaterial(floorMaterial);
+    m_debugDragon->registerMaterials();
+    m_debugDragon->acquireMeshes();
+    vector<Dragon *>::iterator it;
+    for(it = m_dragons.begin(); it != m_dragons.end(); it++)
+    {
+        (*it)->registerMaterials();
+        (*it)->acquireMeshes();
+    }
+
+    // dragons are recorded by jobs when there are threads to run them
+    if((m_jobs->threadCount() > 0) && (m_dragons.size() > 1))
+    {
+        for(size_t i = 0; i < m_dragons.size(); i++)
+            m_recorders.push_back(new DrawRecorder(m_state));
+    }
+    buildNodes();
+}
+
+void Scene::buildNodes()
+{
+    // the floor and each dragon are separate trees, which can be updated in parallel
+    RenderState *state = m_state;
+    SceneBuilder builder(state);
+    SceneNode *floor = new SceneNode();
+    builder.begin(floor);
+    setState(&builder);
+    drawFloor();
+    setState(state);
+    builder.end();
+    m_nodes.push_back(floor);
+    for(size_t i = 0; i < m_dragons.size(); i++)
+    {
+        SceneNode *n = new SceneNode();
+        builder.begin(n);
+        m_dragons[i]->setState(&builder);
+        drawDragon(i);
+        m_dragons[i]->setState(state);
+        builder.end();
+        m_nodes.push_back(n);
+    }
+    m_nodeUpdates.resize(m_nodes.size(), 0);
+    m_nodeBounds.resize(m_nodes.size());
+    m_occluders.resize(m_nodes.size());
+    for(size_t i = 0; i < m_nodes.size(); i++)
+        addOccluders(m_nodes[i], m_occluders[i]);
+}
+
+void Scene::freeNodes()
+{
+    for(size_t i = 0; i < m_nodes.size(); i++)
+        delete m_nodes[i];
+    m_nodes.clear();
+    m_nodeUpdates.clear();
+    m_nodeBounds.clear();
+    m_occluders.clear();
+    m_visibleNodes.clear();
+    m_rayHits.clear();
+}
+
+void Scene::addOccluders(SceneNode *n, vector<SceneNode *> &occluders)
+{
+    // large meshes which hide much of what is behind them
+    Mesh *m = n->mesh();
+    if(m && ((m == m_state->mesh(m_meshes[FloorMesh])) || (m == m_state->mesh(m_meshes[ChestMesh]))))
+        occluders.push_back(n);
+    for(size_t i = 0; i < n->children().size(); i++)
+        addOccluders(n->children()[i], occluders);
+}
+
+void Scene::spawnCrowd(int count)
+{
+    // jittered grid, the same for a given count so that runs can be compared
+    uint32_t seed = 0x5eed;
+    int side = (int)ceil(sqrt((double)count));
+    float spacing = 5.0;
+    for(int i = 0; i < count; i++)
+    {
+        CrowdPlacement p;
+        float x = (i % side) - (side - 1) * 0.5;
+        float z = (i / side) - (side - 1) * 0.5;
+        p.position.x = (x + crowdUniform(seed, -0.2, 0.2)) * spacing;
+        p.position.y = crowdUniform(seed, 1.5, 3.0);
+        p.position.z = (z + crowdUniform(seed, -0.2, 0.2)) * spacing;
+        p.heading = crowdUniform(seed, 0.0, 360.0);
+        p.size = crowdUniform(seed, 1.2, 2.0);
+        float timeOffset = crowdUniform(seed, 0.0, 10.0);
+        p.letter = crowdRandom(seed) % 3;
+        p.variant = crowdRandom(seed) % 4;
+        Dragon::Kind kind = (Dragon::Kind)(crowdRandom(seed) % 3);
+        m_crowd.push_back(p);
+        m_dragons.push_back(new Dragon(kind, m_state, m_poses));
+        m_poses->setTimeOffset(i, timeOffset);
+    }
+}
+
+int Scene::crowdSize() const
+{
+    return m_crowd.size();
 }
 
 void Scene::reset()
 {
+    discardPrepared();
     m_delta = vec3(-0.0, -0.5, -5.0);
     m_theta = vec3(21.0, -37.0, 0.0);
     m_sigma = 0.40;
+    if(!m_crowd.empty())
+    {
+        // zoom out as the crowd grows
+        float extent = 0.0;
+        for(size_t i = 0; i < m_crowd.size(); i++)
+        {
+            extent = max(extent, (float)fabs(m_crowd[i].position.x));
+            extent = max(extent, (float)fabs(m_crowd[i].position.z));
+        }
+        m_sigma = min(m_sigma, 4.0f / (extent + 2.0f));
+    }
     m_selected = SCENE;
     m_thetaCamera = vec3(0, 0, 0);
     m_detailLevel = 4;
@@ -132,7 +370,11 @@ void Scene::draw()
     m_state->rotate(rot.z, 0.0, 0.0, 1.0);
     m_state->scale(m_sigma, m_sigma, m_sigma);
 
+    double started = currentTime();
     drawItem(i);
+    m_drawTime = currentTime() - started;
+    // what was prepared is only good for this frame
+    discardPrepared();
     if(m_exportQueued)
     {
         stringstream ss;
@@ -142,6 +384,78 @@ void Scene::draw()
     }
 }
 
+void Scene::prepareFrame()
+{
+    discardPrepared();
+    if(m_selected != SCENE)
+        return;
+    if(m_retained && !m_nodes.empty())
+    {
+        // assume the camera does not move, the draw checks it did not
+        m_preparedView = viewMatrix();
+        m_cullProjection = m_state->projectionMatrix();
+        m_preparing = m_prepared = true;
+        m_jobs->submit(prepareNodesTask, this, 0, &m_preparation);
+        return;
+    }
+    if(m_recorders.empty())
+        return;
+
+    // the view is not known yet, so the dragons are recorded from the identity
+    matrix4 identity;
+    identity.setIdentity();
+    for(size_t i = 0; i < m_dragons.size(); i++)
+    {
+        m_recorders[i]->begin(identity);
+        m_dragons[i]->setState(m_recorders[i]);
+    }
+    m_preparing = m_prepared = true;
+    m_jobs->submit(recordDragonsTask, this, 0, &m_preparation);
+}
+
+void Scene::discardPrepared()
+{
+    if(m_preparing)
+    {
+        m_jobs->wait(m_preparation);
+        for(size_t i = 0; i < m_dragons.size(); i++)
+            m_dragons[i]->setState(m_state);
+        m_preparing = false;
+    }
+    m_prepared = false;
+}
+
+void Scene::recordDragonsTask(void *arg, int index)
+{
+    (void)index;
+    Scene *scene = (Scene *)arg;
+    scene->m_jobs->parallelFor(drawDragonTask, scene, scene->m_dragons.size());
+}
+
+void Scene::prepareNodesTask(void *arg, int index)
+{
+    (void)index;
+    Scene *scene = (Scene *)arg;
+    scene->m_preparedUpdates = scene->updateNodes(scene->m_preparedView);
+    if(scene->m_culling)
+        scene->cullNodes();
+}
+
+// The view draw() sets up for the scene, from the identity the frame starts
+// with. Same multiplications as the state, so that both can be compared.
+matrix4 Scene::viewMatrix() const
+{
+    vec3 rot = m_theta + m_thetaCamera;
+    matrix4 m;
+    m.setIdentity();
+    m = m * matrix4::translate(m_delta.x, m_delta.y, m_delta.z);
+    m = m * matrix4::rotate(rot.x, 1.0, 0.0, 0.0);
+    m = m * matrix4::rotate(rot.y, 0.0, 1.0, 0.0);
+    m = m * matrix4::rotate(rot.z, 0.0, 0.0, 1.0);
+    m = m * matrix4::scale(m_sigma, m_sigma, m_sigma);
+    return m;
+}
+
 void Scene::drawItem(Scene::Item item)
 {
     pushMatrix();
@@ -155,13 +469,13 @@ void Scene::drawItem(Scene::Item item)
         switch(item)
         {
         case LETTER_P:
-            drawMesh("letter_p");
+            drawMesh(m_meshes[LetterPMesh]);
             break;
         case LETTER_A:
-            drawMesh("letter_a");
+            drawMesh(m_meshes[LetterAMesh]);
             break;
         case LETTER_S:
-            drawMesh("letter_s");
+            drawMesh(m_meshes[LetterSMesh]);
             break;
         case DRAGON:
             m_debugDragon->draw();
@@ -216,9 +530,11 @@ void Scene::drawItem(Scene::Item item)
 
 void Scene::exportItem(Item item, string path)
 {
+    m_exporting = true;
     m_state->beginExportMesh(path);
     drawItem(item);
     m_state->endExportMesh();
+    m_exporting = false;
 }
 
 void Scene::exportCurrentItem()
@@ -274,97 +590,347 @@ string Scene::itemText(Scene::Item item)
 
 void Scene::drawScene()
 {
+    // kept for picking, even when the nodes are not drawn
+    m_view = m_state->currentMatrix();
+    bool prepared = m_prepared;
+    discardPrepared();
+    if(m_retained && !m_nodes.empty())
+    {
+        drawNodes(prepared);
+        return;
+    }
+
     drawFloor();
 
-    Dragon *da = m_dragons[0];
-    pushMatrix();
-        translate(0.0, 2.0 + 0.6 * da->alpha(), 0.0);
-        scale(3.0, 3.0, 3.0);
-        da->setDetailLevel(m_detailLevel);
-        drawDragonHoldingA(da);
-    popMatrix();
+    if(m_recorders.empty())
+    {
+        for(size_t i = 0; i < m_dragons.size(); i++)
+            drawDragon(i);
+        return;
+    }
 
-    Dragon *dp = m_dragons[1];
-    pushMatrix();
-        translate(-dp->beta(), dp->beta(), dp->beta());
-        rotate(dp->alpha(), 0.0, 1.0, 0.0);
-        translate(4.0, 0.0, 4.0);
-        rotate(60.0, 0.0, 1.0, 0.0);
-        scale(1.5, 1.5, 1.5);
-        dp->setDetailLevel(m_detailLevel);
-        drawDragonHoldingP(dp);
-    popMatrix();
+    if(prepared)
+    {
+        for(size_t i = 0; i < m_dragons.size(); i++)
+            m_recorders[i]->replay(m_state, m_view);
+        return;
+    }
 
-    Dragon *ds = m_dragons[2];
-    pushMatrix();
-        translate(0.0, ds->beta(), 0.0);
-        rotate(-ds->alpha(), 0.0, 1.0, 0.0);
-        translate(3.0, 0.0, 3.0);
-        rotate(-120.0, 0.0, 1.0, 0.0);
-        scale(1.5, 1.5, 1.5);
-        ds->setDetailLevel(m_detailLevel);
-        drawDragonHoldingS(ds);
-    popMatrix();
+    // record the dragons in jobs, then draw them in order
+    matrix4 modelView = m_state->currentMatrix();
+    for(size_t i = 0; i < m_dragons.size(); i++)
+    {
+        m_recorders[i]->begin(modelView);
+        m_dragons[i]->setState(m_recorders[i]);
+    }
+    m_jobs->parallelFor(drawDragonTask, this, m_dragons.size());
+    for(size_t i = 0; i < m_dragons.size(); i++)
+    {
+        m_dragons[i]->setState(m_state);
+        m_recorders[i]->replay(m_state);
+    }
+}
+
+int Scene::updateNodes(const matrix4 &view)
+{
+    // every world matrix depends on the view, so compare it with the one
+    // the nodes were last updated with
+    m_viewChanged = !sameMatrix(view, m_nodeView);
+    m_nodeView = view;
+    m_jobs->parallelFor(updateNodeTask, this, m_nodes.size());
+    int updated = 0;
+    for(size_t i = 0; i < m_nodes.size(); i++)
+        updated += m_nodeUpdates[i];
+
+    // the tree only needs to be refit to where the nodes moved
+    for(size_t i = 0; i < m_nodes.size(); i++)
+    {
+        BoundingVolumeHierarchy::Bounds &b = m_nodeBounds[i];
+        b.center = m_nodes[i]->boundsCenter();
+        b.radius = m_nodes[i]->boundsRadius();
+        b.weight = m_nodes[i]->meshCount();
+    }
+    m_nodeTree.update(m_nodeBounds);
+    return updated;
+}
+
+// Find the trees of nodes in view of the culling projection. Does not use
+// the state, so that it can run in a job.
+void Scene::cullNodes()
+{
+    m_nodeFrustum.setProjection(m_cullProjection);
+    const OcclusionCuller *occlusion = 0;
+    if(m_occlusion)
+    {
+        // only the trees in view can hide something
+        int outside = 0, occluded = 0;
+        m_nodeTree.cull(m_nodeFrustum, 0, m_visibleNodes, outside, occluded);
+        m_occlusionCuller->begin(m_cullProjection);
+        for(size_t i = 0; i < m_visibleNodes.size(); i++)
+        {
+            const vector<SceneNode *> &occluders = m_occluders[m_visibleNodes[i].index];
+            for(size_t j = 0; j < occluders.size(); j++)
+            {
+                SceneNode *n = occluders[j];
+                if(m_nodeFrustum.test(n->boundsCenter(), n->boundsRadius()) != Frustum::Outside)
+                    m_occlusionCuller->addOccluder(n->mesh(), n->worldMatrix());
+            }
+        }
+        m_occlusionCuller->end();
+        occlusion = m_occlusionCuller;
+    }
+    m_cullOutside = m_cullOccluded = 0;
+    m_nodeTree.cull(m_nodeFrustum, occlusion, m_visibleNodes, m_cullOutside, m_cullOccluded);
+}
+
+void Scene::drawNodes(bool prepared)
+{
+    // what the job prepared is only good when the camera did not move
+    matrix4 projection = m_state->projectionMatrix();
+    if(prepared)
+        prepared = sameMatrix(m_view, m_nodeView) && sameMatrix(projection, m_cullProjection);
+    m_nodesUpdated = prepared ? m_preparedUpdates : updateNodes(m_view);
+
+    // exported meshes include what is out of view
+    bool culling = m_culling && !m_exporting;
+    m_state->pushMatrix();
+    if(!culling)
+    {
+        for(size_t i = 0; i < m_nodes.size(); i++)
+            m_nodes[i]->draw(m_state);
+        m_state->popMatrix();
+        m_meshesOutside = m_meshesOccluded = 0;
+        return;
+    }
+
+    if(!prepared)
+    {
+        m_cullProjection = projection;
+        cullNodes();
+    }
+    const OcclusionCuller *occlusion = m_occlusion ? m_occlusionCuller : 0;
+    SceneNode::CullCounts counts;
+    counts.outside = m_cullOutside;
+    counts.occluded = m_cullOccluded;
+    for(size_t i = 0; i < m_visibleNodes.size(); i++)
+    {
+        const BoundingVolumeHierarchy::Visible &v = m_visibleNodes[i];
+        m_nodes[v.index]->draw(m_state, v.inside ? 0 : &m_nodeFrustum, occlusion, counts);
+    }
+    m_state->popMatrix();
+    m_meshesOutside = counts.outside;
+    m_meshesOccluded = counts.occluded;
+    m_treeSpheres = m_nodeTree.nodeCount();
+    m_treeBuilds = m_nodeTree.rebuildCount();
+    m_occluderTriangles = m_occlusionCuller->occluderTriangles();
+}
+
+void Scene::updateNodeTask(void *arg, int index)
+{
+    ((Scene *)arg)->updateNode(index);
+}
+
+void Scene::updateNode(int index)
+{
+    m_nodeUpdates[index] = m_nodes[index]->update(m_nodeView, m_viewChanged);
+}
+
+void Scene::drawDragonTask(void *arg, int index)
+{
+    ((Scene *)arg)->drawDragon(index);
+}
+
+void Scene::drawDragon(int index)
+{
+    // only use the dragon's state here, which may be a recorder
+    Dragon *d = m_dragons[index];
+    d->setDetailLevel(m_detailLevel);
+    if(!m_crowd.empty())
+    {
+        drawCrowdDragon(index);
+        return;
+    }
+    d->pushMatrix();
+    switch(index)
+    {
+    case 0:
+        d->translate(0.0, bind(d->alpha(), 0.6, 2.0), 0.0);
+        d->scale(3.0, 3.0, 3.0);
+        drawDragonHoldingA(d);
+        break;
+    case 1:
+        d->translate(bind(d->beta(), -1.0), bind(d->beta()), bind(d->beta()));
+        d->rotate(bind(d->alpha()), 0.0, 1.0, 0.0);
+        d->translate(4.0, 0.0, 4.0);
+        d->rotate(60.0, 0.0, 1.0, 0.0);
+        d->scale(1.5, 1.5, 1.5);
+        drawDragonHoldingP(d);
+        break;
+    case 2:
+        d->translate(0.0, bind(d->beta()), 0.0);
+        d->rotate(bind(d->alpha(), -1.0), 0.0, 1.0, 0.0);
+        d->translate(3.0, 0.0, 3.0);
+        d->rotate(-120.0, 0.0, 1.0, 0.0);
+        d->scale(1.5, 1.5, 1.5);
+        drawDragonHoldingS(d);
+        break;
+    }
+    d->popMatrix();
+}
+
+void Scene::drawCrowdDragon(int index)
+{
+    Dragon *d = m_dragons[index];
+    const CrowdPlacement &p = m_crowd[index];
+    d->pushMatrix();
+    d->translate(p.position.x, bind(d->wingBeat(), 0.3, p.position.y), p.position.z);
+    d->rotate(p.heading, 0.0, 1.0, 0.0);
+    d->scale(p.size, p.size, p.size);
+    switch(p.letter)
+    {
+    case 0:
+        drawDragonHoldingA(d);
+        break;
+    case 1:
+        drawDragonHoldingP(d);
+        break;
+    case 2:
+        drawDragonHoldingS(d);
+        break;
+    }
+    d->popMatrix();
 }
 
 void Scene::drawFloor()
 {
     pushMaterial(floorMaterial);
-    drawMesh("floor");
+    drawMesh(m_meshes[FloorMesh]);
     popMaterial();
 }
 
 void Scene::drawDragonHoldingA(Dragon *d)
 {
-    pushMatrix();
-        pushMatrix();
-            rotate(45.0, 0.0, 0.0, 1.0);
+    d->pushMatrix();
+        d->pushMatrix();
+            d->rotate(45.0, 0.0, 0.0, 1.0);
             d->draw();
-        popMatrix();
-        pushMatrix();
-            translate(1.0/3.0, 0.2/3.0, 0.0);
-            rotate(15.0, 0.0, 1.0, 0.0);
-            rotate(-d->frontLegsAngle(), 0.0, 0.0, 1.0);
-            scale(2.0/3.0, 2.0/3.0, 1.0/3.0);
-            pushMaterial(d->tongueMaterial());
-            drawMesh("letter_a");
-            popMaterial();
-        popMatrix();
-    popMatrix();
+        d->popMatrix();
+        d->pushMatrix();
+            d->translate(1.0/3.0, 0.2/3.0, 0.0);
+            d->rotate(15.0, 0.0, 1.0, 0.0);
+            d->rotate(bind(d->frontLegsAngle(), -1.0), 0.0, 0.0, 1.0);
+            d->scale(2.0/3.0, 2.0/3.0, 1.0/3.0);
+            d->pushMaterial(d->tongueMaterial());
+            d->pushName(LETTER_A);
+            d->drawMesh(m_meshes[LetterAMesh]);
+            d->popName();
+            d->popMaterial();
+        d->popMatrix();
+    d->popMatrix();
 }
 
 void Scene::drawDragonHoldingP(Dragon *d)
 {
-    pushMatrix();
+    d->pushMatrix();
         d->draw();
-        pushMatrix();
-            translate(0.08, -0.13, 0.0);
-            rotate(-d->frontLegsAngle() + 90.0, 0.0, 0.0, 1.0);
-            translate(0.2, -0.1, 0.0);
-            rotate(-170, 0.0, 0.0, 1.0);
-            scale(1.0, 1.0, 0.5);
-            pushMaterial(d->tongueMaterial());
-            drawMesh("letter_p");
-            popMaterial();
-        popMatrix();
-    popMatrix();
+        d->pushMatrix();
+            d->translate(0.08, -0.13, 0.0);
+            d->rotate(bind(d->frontLegsAngle(), -1.0, 90.0), 0.0, 0.0, 1.0);
+            d->translate(0.2, -0.1, 0.0);
+            d->rotate(-170, 0.0, 0.0, 1.0);
+            d->scale(1.0, 1.0, 0.5);
+            d->pushMaterial(d->tongueMaterial());
+            d->pushName(LETTER_P);
+            d->drawMesh(m_meshes[LetterPMesh]);
+            d->popName();
+            d->popMaterial();
+        d->popMatrix();
+    d->popMatrix();
 }
 
 void Scene::drawDragonHoldingS(Dragon *d)
 {
-    pushMatrix();
+    d->pushMatrix();
         d->draw();
-        pushMatrix();
-            translate(0.26, -0.25, 0.0);
-            rotate(180.0 - d->frontLegsAngle(), 0.0, 0.0, 1.0);
+        d->pushMatrix();
+            d->translate(0.26, -0.25, 0.0);
+            d->rotate(bind(d->frontLegsAngle(), -1.0, 180.0), 0.0, 0.0, 1.0);
             // need to change the center of the rotation
-            translate(-0.4, 0.1, 0.0);
-            scale(1.0, 1.0, 0.5);
-            pushMaterial(d->tongueMaterial());
-            drawMesh("letter_s");
-            popMaterial();
-        popMatrix();
-    popMatrix();
+            d->translate(-0.4, 0.1, 0.0);
+            d->scale(1.0, 1.0, 0.5);
+            d->pushMaterial(d->tongueMaterial());
+            d->pushName(LETTER_S);
+            d->drawMesh(m_meshes[LetterSMesh]);
+            d->popName();
+            d->popMaterial();
+        d->popMatrix();
+    d->popMatrix();
+}
+
+Scene::PickResult Scene::pick(float x, float y)
+{
+    PickResult r;
+    r.item = SCENE;
+    r.dragon = -1;
+    r.distance = 0.0;
+    // the job preparing the next frame also moves the nodes
+    discardPrepared();
+    if(m_nodes.empty())
+        return r;
+    double started = currentTime();
+    updateNodes(m_view);
+
+    // the ray goes from the near plane to the far plane, in eye space
+    matrix4 inv = m_state->projectionMatrix().inverse();
+    vec3 points[2];
+    for(int i = 0; i < 2; i++)
+    {
+        float z = (i == 0) ? -1.0 : 1.0;
+        const float *d = inv.d;
+        float w = d[3] * x + d[7] * y + d[11] * z + d[15];
+        if(w == 0.0)
+            return r;
+        points[i] = vec3((d[0] * x + d[4] * y + d[8] * z + d[12]) / w,
+                         (d[1] * x + d[5] * y + d[9] * z + d[13]) / w,
+                         (d[2] * x + d[6] * y + d[10] * z + d[14]) / w);
+    }
+    vec3 direction = points[1] - points[0];
+
+    // visit the trees whose sphere is hit, until the nearest mesh hit is
+    // closer than what is left
+    float distance = 1.0;
+    const SceneNode *hit = 0;
+    int hitTree = -1;
+    m_nodeTree.intersect(points[0], direction, m_rayHits);
+    for(size_t i = 0; i < m_rayHits.size(); i++)
+    {
+        const BoundingVolumeHierarchy::RayHit &h = m_rayHits[i];
+        if(h.distance >= distance)
+            break;
+        if(m_nodes[h.index]->intersect(points[0], direction, distance, hit))
+            hitTree = h.index;
+    }
+
+    // the first tree is the floor
+    if(hit && (hitTree >= 1) && (hit->name() >= 0))
+    {
+        r.item = (Item)hit->name();
+        r.dragon = hitTree - 1;
+        r.distance = distance * sqrt(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+    }
+    m_lastPick = r;
+    m_pickTime = currentTime() - started;
+    return r;
+}
+
+Scene::Item Scene::selected() const
+{
+    return (Item)m_selected;
+}
+
+void Scene::select(Item item)
+{
+    m_selected = item;
 }
 
 void Scene::selectNext()
@@ -404,25 +970,142 @@ void Scene::setCamera(Scene::Camera c)
     m_camera = c;
 }
 
+bool Scene::retained() const
+{
+    return m_retained;
+}
+
+void Scene::setRetained(bool enabled)
+{
+    discardPrepared();
+    m_retained = enabled;
+}
+
+bool Scene::culling() const
+{
+    return m_culling;
+}
+
+void Scene::setCulling(bool enabled)
+{
+    discardPrepared();
+    m_culling = enabled;
+}
+
+bool Scene::occlusionCulling() const
+{
+    return m_occlusion;
+}
+
+void Scene::setOcclusionCulling(bool enabled)
+{
+    discardPrepared();
+    m_occlusion = enabled;
+}
+
+string Scene::statistics() const
+{
+    stringstream ss;
+    ss.setf(ios::fixed);
+    ss.precision(2);
+    ss << "Dragons: " << m_dragons.size() << " (animated in "
+       << m_animationTime * 1000.0 << " ms, drawn in "
+       << m_drawTime * 1000.0 << " ms)" << endl;
+    if(m_pickTime >= 0.0)
+    {
+        if(m_lastPick.dragon >= 0)
+            ss << "Picked: " << itemText(m_lastPick.item) << " of dragon " << m_lastPick.dragon;
+        else
+            ss << "Picked: nothing";
+        ss << " (" << m_pickTime * 1000.0 << " ms)" << endl;
+    }
+    if(m_retained && !m_nodes.empty())
+    {
+        ss << "Scene nodes updated: " << m_nodesUpdated << endl;
+        if(m_culling)
+        {
+            ss << "Node tree: " << m_treeSpheres << " spheres, built "
+               << m_treeBuilds << " times" << endl;
+            ss << "Meshes culled: " << m_meshesOutside << " outside, ";
+            if(m_occlusion)
+                ss << m_meshesOccluded << " occluded ("
+                   << m_occluderTriangles << " occluder triangles)";
+            else
+                ss << "occlusion disabled";
+        }
+        else
+            ss << "Culling disabled";
+    }
+    else
+        ss << "Scene drawn immediately";
+    return ss.str();
+}
+
 void Scene::animate()
 {
-    double t = currentTime() - m_started;
-    double angle = fmod(t * 45.0, 360.0);
+    discardPrepared();
+    double started = currentTime();
+    float angle;
+    simulate(started - m_started, *m_poses, angle);
+    followAngle(angle);
+    m_animationTime = currentTime() - started;
+}
+
+double Scene::elapsed() const
+{
+    return currentTime() - m_started;
+}
+
+const DragonPoses & Scene::poses() const
+{
+    return *m_poses;
+}
+
+void Scene::simulate(double t, DragonPoses &poses, float &angle) const
+{
+    angle = fmod(t * 45.0, 360.0);
 
-    // hovering dragon
-    m_dragons[0]->animate(t);
-    m_dragons[0]->setAlpha(cos(t * 3.5 + M_PI));
+    // every dragon at once, those of the crowd at their own pace. They
+    // hover as they beat their wings, which follows their pose.
+    poses.animate(t);
+    if(!m_crowd.empty())
+        return;
+
+    // poses are in the same order as the dragons
+    // hovering dragon, going up as its wings go down
+    poses.value(DragonPoses::Alpha, 0) = -poses.value(DragonPoses::WingBeat, 0);
 
     // drunk dragon trying to fly clockwise
-    m_dragons[1]->animate(t);
-    m_dragons[1]->setAlpha(angle);
-    m_dragons[1]->setBeta(cos(t * 3.5) * cos(t) * cos(t));
+    poses.value(DragonPoses::Alpha, 1) = angle;
+    poses.value(DragonPoses::Beta, 1) = m_flyingCurve.value(t);
 
     // dragon jumping anticlockwise
-    m_dragons[2]->animate(t);
-    m_dragons[2]->setAlpha(angle);
-    m_dragons[2]->setBeta(1.20 * sqrt(fabs(cos(5.0 * t) - cos(6.0 * t) + cos(7.0 * t))));
+    poses.value(DragonPoses::Alpha, 2) = angle;
+    poses.value(DragonPoses::Beta, 2) = 1.20 * sqrt(fabs(m_jumpingCurve.value(t)));
+}
+
+void Scene::showPoses(const DragonPoses &from, const DragonPoses &to, float f, float angle)
+{
+    discardPrepared();
+    double started = currentTime();
+    m_poses->interpolate(from, to, f);
+    followAngle(angle);
+    m_animationTime = currentTime() - started;
+}
+
+const AnimationCurve::Source * Scene::curveSources(int &count)
+{
+    count = sizeof(sceneCurves) / sizeof(AnimationCurve::Source);
+    return sceneCurves;
+}
 
+void Scene::followAngle(float angle)
+{
+    if(!m_crowd.empty())
+    {
+        m_thetaCamera.y = (m_camera == Camera_Static) ? 0.0 : angle;
+        return;
+    }
     switch(m_camera)
     {
     default:
@@ -462,6 +1145,45 @@ float Scene::spaced_cos(float x, float w, float a)
     return cos(2.0 * M_PI * spaced_sawtooth(x, w, a) + M_PI / 2.0);
 }
 
+// Parse a mesh file of the scene, on any thread
+void loadMeshTask(void *arg, int index)
+{
+    MeshFile *f = (MeshFile *)arg + index;
+    f->group = Mesh::loadObj(f->path);
+}
+
+// Height of the drunk dragon, baked at load
+double flyingCurve(double t)
+{
+    return cos(t * 3.5) * cos(t) * cos(t);
+}
+
+// Jumps of the other dragon, before the square root which is not baked
+// because the table would need too many samples near its zeros
+double jumpingCurve(double t)
+{
+    return cos(5.0 * t) - cos(6.0 * t) + cos(7.0 * t);
+}
+
+// Linear congruential generator, so that crowds look the same on every platform
+uint32_t crowdRandom(uint32_t &seed)
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+}
+
+// Random number between low and high
+float crowdUniform(uint32_t &seed, float low, float high)
+{
+    return low + (high - low) * (crowdRandom(seed) / 16777216.0f);
+}
+
+// Compare matrices bit by bit, as computed by the same multiplications
+bool sameMatrix(const matrix4 &a, const matrix4 &b)
+{
+    return memcmp(a.d, b.d, sizeof(a.d)) == 0;
+}
+
 #ifdef WIN32
 #include <windows.h>
 double currentTime()
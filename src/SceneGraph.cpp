@@ -0,0 +1,534 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <algorithm>
+#include "SceneGraph.h"
+#include "TriangleTree.h"
+
+SceneNode::SceneNode(SceneNode *parent)
+{
+    m_parent = parent;
+    m_mesh = 0;
+    m_material = 0;
+    m_name = -1;
+    m_world.setIdentity();
+    m_meshCenter = m_center = vec3(0.0, 0.0, 0.0);
+    m_meshRadius = m_radius = -1.0;
+    m_meshCount = 0;
+    m_dirty = true;
+    m_animated = false;
+}
+
+SceneNode::~SceneNode()
+{
+    for(size_t i = 0; i < m_children.size(); i++)
+        delete m_children[i];
+}
+
+SceneNode * SceneNode::parent() const
+{
+    return m_parent;
+}
+
+const vector<SceneNode *> & SceneNode::children() const
+{
+    return m_children;
+}
+
+SceneNode * SceneNode::addChild()
+{
+    SceneNode *n = new SceneNode(this);
+    m_children.push_back(n);
+    return n;
+}
+
+void SceneNode::multiplyMatrix(const matrix4 &m)
+{
+    Transform t;
+    t.kind = Matrix;
+    t.matrix = m;
+    addTransform(t);
+}
+
+void SceneNode::translate(const Binding &dx, const Binding &dy, const Binding &dz)
+{
+    Transform t;
+    t.kind = Translation;
+    t.x = dx;
+    t.y = dy;
+    t.z = dz;
+    addTransform(t);
+}
+
+void SceneNode::rotate(const Binding &angle, float rx, float ry, float rz)
+{
+    Transform t;
+    t.kind = Rotation;
+    t.x = angle;
+    t.axis = vec3(rx, ry, rz);
+    addTransform(t);
+}
+
+void SceneNode::scale(float sx, float sy, float sz)
+{
+    Transform t;
+    t.kind = Scaling;
+    t.x = sx;
+    t.y = sy;
+    t.z = sz;
+    addTransform(t);
+}
+
+Mesh * SceneNode::mesh() const
+{
+    return m_mesh;
+}
+
+void SceneNode::setMesh(Mesh *m)
+{
+    m_mesh = m;
+}
+
+const Material * SceneNode::material() const
+{
+    return m_material;
+}
+
+void SceneNode::setMaterial(const Material *m)
+{
+    m_material = m;
+}
+
+int SceneNode::name() const
+{
+    return m_name;
+}
+
+void SceneNode::setName(int name)
+{
+    m_name = name;
+}
+
+const matrix4 & SceneNode::worldMatrix() const
+{
+    return m_world;
+}
+
+const vec3 & SceneNode::boundsCenter() const
+{
+    return m_center;
+}
+
+float SceneNode::boundsRadius() const
+{
+    return m_radius;
+}
+
+int SceneNode::meshCount() const
+{
+    return m_meshCount;
+}
+
+void SceneNode::addTransform(const Transform &t)
+{
+    m_transforms.push_back(t);
+    Transform &added = m_transforms.back();
+    computeTransform(added);
+    if(added.x.param || added.y.param || added.z.param)
+        setAnimated();
+    m_dirty = true;
+}
+
+void SceneNode::setAnimated()
+{
+    for(SceneNode *n = this; n && !n->m_animated; n = n->m_parent)
+        n->m_animated = true;
+}
+
+void SceneNode::computeTransform(Transform &t)
+{
+    t.last[0] = t.x.param ? *t.x.param : 0.0f;
+    t.last[1] = t.y.param ? *t.y.param : 0.0f;
+    t.last[2] = t.z.param ? *t.z.param : 0.0f;
+    switch(t.kind)
+    {
+    case Matrix:
+        break;
+    case Translation:
+        t.matrix = matrix4::translate(t.x.value(), t.y.value(), t.z.value());
+        break;
+    case Rotation:
+        t.matrix = matrix4::rotate(t.x.value(), t.axis.x, t.axis.y, t.axis.z);
+        break;
+    case Scaling:
+        t.matrix = matrix4::scale(t.x.value(), t.y.value(), t.z.value());
+        break;
+    }
+}
+
+bool SceneNode::updateTransform(Transform &t)
+{
+    if((t.x.param && (*t.x.param != t.last[0])) ||
+       (t.y.param && (*t.y.param != t.last[1])) ||
+       (t.z.param && (*t.z.param != t.last[2])))
+    {
+        computeTransform(t);
+        return true;
+    }
+    return false;
+}
+
+int SceneNode::update(const matrix4 &parentWorld, bool parentChanged)
+{
+    // nothing can have changed in a static subtree whose parent did not move
+    if(!parentChanged && !m_dirty && !m_animated)
+        return 0;
+    bool changed = parentChanged || m_dirty;
+    for(size_t i = 0; i < m_transforms.size(); i++)
+    {
+        if(updateTransform(m_transforms[i]))
+            changed = true;
+    }
+
+    int updated = 0;
+    if(changed)
+    {
+        // same order of multiplications as drawing the script
+        m_world = parentWorld;
+        for(size_t i = 0; i < m_transforms.size(); i++)
+            m_world = m_world * m_transforms[i].matrix;
+        m_dirty = false;
+        updated++;
+    }
+    for(size_t i = 0; i < m_children.size(); i++)
+        updated += m_children[i]->update(m_world, changed);
+    if(updated > 0)
+        updateBounds();
+    return updated;
+}
+
+void SceneNode::updateBounds()
+{
+    m_meshCount = 0;
+    m_meshRadius = -1.0;
+    if(m_mesh && m_mesh->hasBounds())
+    {
+        const float *d = m_world.d;
+        const vec3 &c = m_mesh->boundsCenter();
+        m_meshCenter = vec3(d[0] * c.x + d[4] * c.y + d[8] * c.z + d[12],
+                            d[1] * c.x + d[5] * c.y + d[9] * c.z + d[13],
+                            d[2] * c.x + d[6] * c.y + d[10] * c.z + d[14]);
+        // the radius grows with the largest scale of the matrix
+        float scale2 = 0.0;
+        for(int i = 0; i < 3; i++)
+        {
+            const float *axis = d + i * 4;
+            scale2 = max(scale2, axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        }
+        m_meshRadius = m_mesh->boundsRadius() * sqrt(scale2);
+    }
+    if(m_mesh)
+        m_meshCount++;
+
+    m_center = m_meshCenter;
+    m_radius = m_meshRadius;
+    for(size_t i = 0; i < m_children.size(); i++)
+    {
+        const SceneNode *child = m_children[i];
+        m_meshCount += child->m_meshCount;
+        if(child->m_radius < 0.0)
+            continue;
+        if(m_radius < 0.0)
+        {
+            m_center = child->m_center;
+            m_radius = child->m_radius;
+        }
+        else
+        {
+            mergeSpheres(m_center, m_radius, child->m_center, child->m_radius);
+        }
+    }
+}
+
+void SceneNode::draw(RenderState *s) const
+{
+    CullCounts counts;
+    counts.outside = counts.occluded = 0;
+    draw(s, 0, 0, counts);
+}
+
+void SceneNode::draw(RenderState *s, const Frustum *frustum, const OcclusionCuller *occlusion,
+                     CullCounts &counts) const
+{
+    if(m_radius >= 0.0)
+    {
+        Frustum::Result r = frustum ? frustum->test(m_center, m_radius) : Frustum::Inside;
+        if(r == Frustum::Outside)
+        {
+            counts.outside += m_meshCount;
+            return;
+        }
+        else if(r == Frustum::Inside)
+        {
+            frustum = 0;            // no need to test the subtree
+        }
+        if(occlusion && occlusion->isOccluded(m_center, m_radius))
+        {
+            counts.occluded += m_meshCount;
+            return;
+        }
+    }
+
+    if(m_material)
+        s->pushMaterial(*m_material);
+    if(m_mesh)
+    {
+        // the sphere of the node is the sphere of the mesh when it has no children
+        bool outside = false, occluded = false;
+        if(!m_children.empty() && (m_meshRadius >= 0.0))
+        {
+            outside = frustum && (frustum->test(m_meshCenter, m_meshRadius) == Frustum::Outside);
+            occluded = !outside && occlusion && occlusion->isOccluded(m_meshCenter, m_meshRadius);
+        }
+        if(outside)
+        {
+            counts.outside++;
+        }
+        else if(occluded)
+        {
+            counts.occluded++;
+        }
+        else
+        {
+            s->loadIdentity();
+            s->multiplyMatrix(m_world);
+            s->drawMesh(m_mesh);
+        }
+    }
+    for(size_t i = 0; i < m_children.size(); i++)
+        m_children[i]->draw(s, frustum, occlusion, counts);
+    if(m_material)
+        s->popMaterial();
+}
+
+bool SceneNode::intersect(const vec3 &origin, const vec3 &direction, float &distance,
+                          const SceneNode *&hit) const
+{
+    // skip the subtree when the ray misses its sphere or only hits it farther away
+    if(m_radius < 0.0)
+        return false;
+    vec3 oc = m_center - origin;
+    float dd = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+    float b = oc.x * direction.x + oc.y * direction.y + oc.z * direction.z;
+    float c = oc.x * oc.x + oc.y * oc.y + oc.z * oc.z - m_radius * m_radius;
+    float disc = b * b - dd * c;
+    if((dd <= 0.0) || (disc < 0.0) || ((b + sqrt(disc)) < 0.0) || (((b - sqrt(disc)) / dd) >= distance))
+        return false;
+
+    bool found = false;
+    if(m_mesh && (m_meshRadius >= 0.0))
+    {
+        // cast the ray in the space of the mesh, where its triangles are
+        matrix4 inv = m_world.inverse();
+        const float *d = inv.d;
+        vec3 o(d[0] * origin.x + d[4] * origin.y + d[8] * origin.z + d[12],
+               d[1] * origin.x + d[5] * origin.y + d[9] * origin.z + d[13],
+               d[2] * origin.x + d[6] * origin.y + d[10] * origin.z + d[14]);
+        vec3 dir(d[0] * direction.x + d[4] * direction.y + d[8] * direction.z,
+                 d[1] * direction.x + d[5] * direction.y + d[9] * direction.z,
+                 d[2] * direction.x + d[6] * direction.y + d[10] * direction.z);
+        if(m_mesh->triangles()->intersect(o, dir, distance))
+        {
+            hit = this;
+            found = true;
+        }
+    }
+    for(size_t i = 0; i < m_children.size(); i++)
+    {
+        if(m_children[i]->intersect(origin, direction, distance, hit))
+            found = true;
+    }
+    return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SceneBuilder::SceneBuilder(const RenderState *target) : RenderState()
+{
+    m_target = target;
+}
+
+void SceneBuilder::begin(SceneNode *root)
+{
+    m_stack.clear();
+    m_stack.push_back(root);
+    m_names.clear();
+}
+
+void SceneBuilder::end()
+{
+    m_stack.clear();
+    m_names.clear();
+}
+
+SceneNode * SceneBuilder::transformedNode()
+{
+    // transforms made after drawing must not move what was already drawn
+    SceneNode *n = m_stack.back();
+    if(n->mesh() || !n->children().empty())
+    {
+        n = n->addChild();
+        m_stack.back() = n;
+    }
+    return n;
+}
+
+Mesh * SceneBuilder::createMesh() const
+{
+    return 0;
+}
+
+void SceneBuilder::drawMesh(Mesh *m)
+{
+    if(!m)
+        return;
+    SceneNode *n = m_stack.back();
+    if(n->mesh() || !n->children().empty())
+        n = n->addChild();
+    n->setMesh(m);
+    if(!m_names.empty())
+        n->setName(m_names.back());
+}
+
+void SceneBuilder::drawMesh(MeshHandle h)
+{
+    drawMesh(m_target->mesh(h));
+}
+
+void SceneBuilder::drawMesh(const string &name)
+{
+    const map<string, Mesh *> &meshes = m_target->meshes();
+    map<string, Mesh *>::const_iterator it = meshes.find(name);
+    if(it != meshes.end())
+        drawMesh(it->second);
+}
+
+void SceneBuilder::freeTextures()
+{
+}
+
+void SceneBuilder::setMatrixMode(MatrixMode newMode)
+{
+    (void)newMode;
+}
+
+void SceneBuilder::loadIdentity()
+{
+    // the scene scripts only make relative transforms
+}
+
+void SceneBuilder::multiplyMatrix(const matrix4 &m)
+{
+    transformedNode()->multiplyMatrix(m);
+}
+
+void SceneBuilder::pushMatrix()
+{
+    m_stack.push_back(m_stack.back()->addChild());
+}
+
+void SceneBuilder::popMatrix()
+{
+    m_stack.pop_back();
+}
+
+void SceneBuilder::translate(float dx, float dy, float dz)
+{
+    transformedNode()->translate(dx, dy, dz);
+}
+
+void SceneBuilder::rotate(float angle, float rx, float ry, float rz)
+{
+    transformedNode()->rotate(angle, rx, ry, rz);
+}
+
+void SceneBuilder::scale(float sx, float sy, float sz)
+{
+    transformedNode()->scale(sx, sy, sz);
+}
+
+matrix4 SceneBuilder::currentMatrix() const
+{
+    matrix4 m;
+    m.setIdentity();
+    return m;
+}
+
+void SceneBuilder::translateAnimated(const Binding &dx, const Binding &dy, const Binding &dz)
+{
+    transformedNode()->translate(dx, dy, dz);
+}
+
+void SceneBuilder::rotateAnimated(const Binding &angle, float rx, float ry, float rz)
+{
+    transformedNode()->rotate(angle, rx, ry, rz);
+}
+
+void SceneBuilder::beginFrame(int width, int heigth)
+{
+    (void)width;
+    (void)heigth;
+}
+
+void SceneBuilder::setupViewport(int width, int heigth)
+{
+    (void)width;
+    (void)heigth;
+}
+
+void SceneBuilder::endFrame()
+{
+}
+
+void SceneBuilder::pushMaterial(const Material &m)
+{
+    SceneNode *n = m_stack.back()->addChild();
+    n->setMaterial(&m);
+    m_stack.push_back(n);
+}
+
+void SceneBuilder::popMaterial()
+{
+    m_stack.pop_back();
+}
+
+void SceneBuilder::pushName(int name)
+{
+    m_names.push_back(name);
+}
+
+void SceneBuilder::popName()
+{
+    m_names.pop_back();
+}
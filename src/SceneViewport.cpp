@@ -33,6 +33,9 @@
 #include "Scene.h"
 #include "Material.h"
 #include "RenderState.h"
+#include "GLTrace.h"
+#include "QualityGovernor.h"
+#include "Simulation.h"
 
 SceneViewport::SceneViewport(Scene *scene, RenderState *state, const QGLFormat &format, QWidget *parent) : QGLWidget(format, parent)
 {
@@ -41,8 +44,13 @@ SceneViewport::SceneViewport(Scene *scene, RenderState *state, const QGLFormat &
     m_state = state;
     m_renderTimer = new QTimer(this);
     m_renderTimer->setInterval(0);
+    m_governor = new QualityGovernor(state);
+    m_governor->setEnabled(true);
+    m_simulation = new Simulation(scene);
+    m_frameTime.start();
     m_frames = 0;
     m_lastFPS = 0;
+    m_showStats = false;
     m_fpsTimer = new QTimer(this);
     m_fpsTimer->setInterval(1000 / 10);
     setAutoFillBackground(false);
@@ -52,8 +60,10 @@ SceneViewport::SceneViewport(Scene *scene, RenderState *state, const QGLFormat &
 
 SceneViewport::~SceneViewport()
 {
+    delete m_simulation;
     makeCurrent();
     m_state->freeTextures();
+    delete m_governor;
 }
 
 void SceneViewport::initializeGL()
@@ -80,8 +90,19 @@ void SceneViewport::paintEvent(QPaintEvent *)
     painter.setRenderHint(QPainter::Antialiasing);
     paintGL();
     m_frames++;
+    // only continuous rendering tells how long frames take
+    double frameTime = m_frameTime.restart() / 1000.0;
+    if(m_animate)
+        m_governor->frameFinished(frameTime);
     if(m_fpsTimer->isActive())
         paintFPS(&painter, m_lastFPS);
+    if(m_showStats)
+    {
+        string stats = m_scene->statistics() + "\n" + m_state->frameStatistics();
+        if(m_governor->enabled())
+            stats = m_governor->statusText() + "\n" + stats;
+        paintStats(&painter, QString::fromStdString(stats));
+    }
 }
 
 void SceneViewport::paintGL()
@@ -89,6 +110,11 @@ void SceneViewport::paintGL()
     m_state->beginFrame(width(), height());
     m_scene->draw();
     m_state->endFrame();
+    // start on the next frame while the GPU draws this one, the state waits
+    // at the beginning of a frame when the GPU is too far behind
+    if(m_animate)
+        m_simulation->apply();
+    m_scene->prepareFrame();
 }
 
 void SceneViewport::resetCamera()
@@ -98,18 +124,58 @@ void SceneViewport::resetCamera()
     m_transState.active = false;
     m_rotState.active = false;
     m_animate = true;
+    // the simulation follows the time of the scene, which starts again
+    m_simulation->stop();
     m_state->reset();
     m_scene->reset();
+    if(m_governor->enabled())
+        m_governor->apply();
     updateAnimationState();
 }
 
 void SceneViewport::toggleAnimation()
 {
     m_animate = !m_animate;
+    m_frameTime.restart();
     if(m_animate)
+    {
+        m_simulation->start();
         m_renderTimer->start();
+    }
     else
+    {
+        m_simulation->stop();
         m_renderTimer->stop();
+    }
+}
+
+void SceneViewport::toggleTrace()
+{
+    // dump the report of every frame while tracing
+    bool enabled = !GLTrace::enabled();
+    GLTrace::setEnabled(enabled);
+    GLTrace::setDumpFile(enabled ? stderr : 0);
+}
+
+void SceneViewport::toggleGovernor()
+{
+    m_governor->setEnabled(!m_governor->enabled());
+}
+
+void SceneViewport::cycleSubmitMode()
+{
+    switch(m_state->submitMode())
+    {
+    case RenderState::Immediate:
+        m_state->setSubmitMode(RenderState::DeferredByState);
+        break;
+    case RenderState::DeferredByState:
+        m_state->setSubmitMode(RenderState::DeferredFrontToBack);
+        break;
+    case RenderState::DeferredFrontToBack:
+        m_state->setSubmitMode(RenderState::Immediate);
+        break;
+    }
 }
 
 void SceneViewport::startFPS()
@@ -136,16 +202,27 @@ void SceneViewport::paintFPS(QPainter *p, float fps)
     p->drawText(QRectF(QPointF(10, 5), QSizeF(100, 100)), text);
 }
 
+void SceneViewport::paintStats(QPainter *p, QString stats)
+{
+    QFont f;
+    f.setPointSizeF(10.0);
+    p->setFont(f);
+    p->setPen(QPen(Qt::white));
+    p->drawText(QRectF(QPointF(10, 35), QSizeF(400, height() - 45)), Qt::AlignLeft | Qt::AlignTop, stats);
+}
+
 void SceneViewport::updateAnimationState()
 {
     if(m_animate)
     {
         startFPS();
+        m_simulation->start();
         m_renderTimer->start();
         m_fpsTimer->start();
     }
     else
     {
+        m_simulation->stop();
         m_renderTimer->stop();
         m_fpsTimer->stop();
     }
@@ -153,7 +230,7 @@ void SceneViewport::updateAnimationState()
 
 void SceneViewport::animateScene()
 {
-    m_scene->animate();
+    // the poses were updated at the end of the last frame
     update();
 }
 
@@ -200,6 +277,27 @@ void SceneViewport::keyReleaseEvent(QKeyEvent *e)
         m_state->toggleProjection();
     else if(key == Qt::Key_Space)
         toggleAnimation();
+    else if(key == Qt::Key_T)
+        m_showStats = !m_showStats;
+    else if(key == Qt::Key_L)
+        cycleSubmitMode();
+    else if(key == Qt::Key_G)
+        toggleTrace();
+    else if(key == Qt::Key_H)
+    {
+        // the governor would change it back
+        bool enabled = !m_state->perPixelLighting();
+        m_governor->setEnabled(false);
+        m_state->setPerPixelLighting(enabled);
+    }
+    else if(key == Qt::Key_A)
+        toggleGovernor();
+    else if(key == Qt::Key_I)
+        m_scene->setRetained(!m_scene->retained());
+    else if(key == Qt::Key_C)
+        m_scene->setCulling(!m_scene->culling());
+    else if(key == Qt::Key_O)
+        m_scene->setOcclusionCulling(!m_scene->occlusionCulling());
     QGLWidget::keyReleaseEvent(e);
     update();
 }
@@ -247,6 +345,10 @@ void SceneViewport::mousePressEvent(QMouseEvent *e)
         m_rotState.last = m_scene->theta();
 		setFocus();
     }
+    else if(e->button() & Qt::RightButton)  // right button picks an item
+    {
+        pickItem(x, y);
+    }
     else
     {
         e->ignore();
@@ -256,6 +358,24 @@ void SceneViewport::mousePressEvent(QMouseEvent *e)
     update();
 }
 
+void SceneViewport::pickItem(int x, int y)
+{
+    // show the item under the cursor alone, or go back to the scene
+    if(m_scene->selected() != Scene::SCENE)
+    {
+        m_scene->select(Scene::SCENE);
+        return;
+    }
+    if((width() <= 0) || (height() <= 0))
+        return;
+    makeCurrent();
+    float px = (2.0 * x / width()) - 1.0;
+    float py = 1.0 - (2.0 * y / height());
+    Scene::PickResult r = m_scene->pick(px, py);
+    if(r.dragon >= 0)
+        m_scene->select(r.item);
+}
+
 void SceneViewport::mouseReleaseEvent(QMouseEvent *e)
 {
     if(e->button() & Qt::MiddleButton)
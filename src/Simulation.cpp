@@ -0,0 +1,122 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <algorithm>
+#include "Simulation.h"
+#include "Scene.h"
+
+using namespace std;
+
+Simulation::Simulation(Scene *scene, double step) : m_last(scene->poses()), m_buffer(Steps(scene->poses()))
+{
+    m_scene = scene;
+    m_step = step;
+    m_lastStep = 0;
+    m_quit = false;
+    m_running = false;
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+double Simulation::step() const
+{
+    return m_step;
+}
+
+bool Simulation::running() const
+{
+    return m_running;
+}
+
+void Simulation::start()
+{
+    if(m_running)
+        return;
+    // the two steps around the time shown, so that there is something to show
+    m_lastStep = (long)floor(m_scene->elapsed() / m_step) - 1;
+    m_last.time = m_lastStep * m_step;
+    m_scene->simulate(m_last.time, m_last.poses, m_last.angle);
+    simulateStep(++m_lastStep);
+    m_buffer.update();
+    m_quit = false;
+    m_running = m_thread.start(threadMain, this);
+}
+
+void Simulation::stop()
+{
+    if(!m_running)
+        return;
+    m_quit = true;
+    m_thread.join();
+    m_running = false;
+}
+
+void Simulation::threadMain(void *arg)
+{
+    ((Simulation *)arg)->run();
+}
+
+void Simulation::run()
+{
+    while(!m_quit)
+    {
+        double now = m_scene->elapsed();
+        double next = (m_lastStep + 1) * m_step;
+        if(now < next)
+        {
+            sleepFor(next - now);
+            continue;
+        }
+        // skip the steps which are already too old to be shown, e.g. when
+        // the process was suspended
+        m_lastStep = max(m_lastStep + 1, (long)floor(now / m_step) - 1);
+        simulateStep(m_lastStep);
+    }
+}
+
+void Simulation::simulateStep(long step)
+{
+    Steps &s = m_buffer.back();
+    s.previous = m_last;
+    m_last.time = step * m_step;
+    m_scene->simulate(m_last.time, m_last.poses, m_last.angle);
+    s.current = m_last;
+    m_buffer.publish();
+}
+
+void Simulation::apply()
+{
+    m_buffer.update();
+    const Snapshot &a = m_buffer.front().previous;
+    const Snapshot &b = m_buffer.front().current;
+    // one step behind, the time is between the two latest steps when the
+    // thread keeps up, otherwise the latest step is shown until it catches up
+    double t = m_scene->elapsed() - m_step;
+    double span = b.time - a.time;
+    float f = (span > 0.0) ? min(max((t - a.time) / span, 0.0), 1.0) : 1.0;
+    m_scene->showPoses(a.poses, b.poses, f, DragonPoses::mix(a.angle, b.angle, f));
+}
@@ -0,0 +1,244 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <sstream>
+#include "Platform.h"
+#include "StateCacheGL2.h"
+#include "GLTrace.h"
+
+StateCacheGL2::StateCacheGL2()
+{
+    clearStats();
+    invalidate();
+}
+
+void StateCacheGL2::invalidate()
+{
+    m_program = Unknown;
+    for(int i = 0; i < MaxBufferTargets; i++)
+        m_buffers[i] = Unknown;
+    // vertex arrays are only used by us and unbound by reset()
+    m_vertexArray = 0;
+    m_activeTexture = Unknown;
+    for(int i = 0; i < MaxTextureUnits; i++)
+        m_textures[i] = Unknown;
+    m_attributes = 0;
+    m_attributesKnown = false;
+    m_material = Unknown;
+}
+
+void StateCacheGL2::reset()
+{
+    enableAttributes(0);
+    bindVertexArray(0);
+    bindBuffer(GL_ARRAY_BUFFER, 0);
+    bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    for(uint32_t i = 0; i < MaxTextureUnits; i++)
+    {
+        if((m_textures[i] != 0) && (m_textures[i] != Unknown))
+        {
+            activeTexture(i);
+            bindTexture(GL_TEXTURE_2D, 0);
+        }
+    }
+    activeTexture(0);
+    useProgram(0);
+    m_material = Unknown;
+}
+
+int StateCacheGL2::bufferTargetIndex(uint32_t target)
+{
+    switch(target)
+    {
+    case GL_ARRAY_BUFFER:
+        return 0;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+void StateCacheGL2::count(Category c, bool issued)
+{
+    if(issued)
+        m_stats.issued[c]++;
+    else
+        m_stats.skipped[c]++;
+}
+
+void StateCacheGL2::useProgram(uint32_t program)
+{
+    bool changed = (m_program != program);
+    if(changed)
+    {
+        glUseProgram(program);
+        m_program = program;
+        // material parameters are stored in the program's uniforms
+        m_material = Unknown;
+    }
+    count(ProgramState, changed);
+}
+
+void StateCacheGL2::bindBuffer(uint32_t target, uint32_t buffer)
+{
+    int i = bufferTargetIndex(target);
+    bool changed = (i < 0) || (m_buffers[i] != buffer);
+    if(changed)
+    {
+        glBindBuffer(target, buffer);
+        if(i >= 0)
+            m_buffers[i] = buffer;
+    }
+    count(BufferState, changed);
+}
+
+void StateCacheGL2::deleteBuffer(uint32_t buffer)
+{
+    if(buffer == 0)
+        return;
+    // deleting a bound buffer reverts the binding to zero
+    for(int i = 0; i < MaxBufferTargets; i++)
+        if(m_buffers[i] == buffer)
+            m_buffers[i] = 0;
+    glDeleteBuffers(1, &buffer);
+}
+
+void StateCacheGL2::bindVertexArray(uint32_t array)
+{
+    bool changed = (m_vertexArray != array);
+    if(changed)
+    {
+        glBindVertexArray(array);
+        m_vertexArray = array;
+    }
+    count(BufferState, changed);
+}
+
+void StateCacheGL2::deleteVertexArray(uint32_t array)
+{
+    if(array == 0)
+        return;
+    if(m_vertexArray == array)
+        m_vertexArray = 0;
+    glDeleteVertexArrays(1, &array);
+}
+
+void StateCacheGL2::activeTexture(uint32_t unit)
+{
+    bool changed = (m_activeTexture != unit);
+    if(changed)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeTexture = unit;
+    }
+    count(TextureState, changed);
+}
+
+void StateCacheGL2::bindTexture(uint32_t target, uint32_t texture)
+{
+    uint32_t unit = m_activeTexture;
+    bool tracked = (target == GL_TEXTURE_2D) && (unit < MaxTextureUnits);
+    bool changed = !tracked || (m_textures[unit] != texture);
+    if(changed)
+    {
+        glBindTexture(target, texture);
+        if(tracked)
+            m_textures[unit] = texture;
+    }
+    count(TextureState, changed);
+}
+
+void StateCacheGL2::deleteTexture(uint32_t texture)
+{
+    if(texture == 0)
+        return;
+    for(int i = 0; i < MaxTextureUnits; i++)
+        if(m_textures[i] == texture)
+            m_textures[i] = 0;
+    glDeleteTextures(1, &texture);
+}
+
+void StateCacheGL2::enableAttributes(uint32_t mask)
+{
+    // vertex array objects keep their own attribute state
+    if(m_vertexArray != 0)
+        bindVertexArray(0);
+    // when the state is unknown, touch every array that is always supported
+    uint32_t changes = m_attributesKnown ? (m_attributes ^ mask) : (mask | 0xffff);
+    for(uint32_t i = 0; i < 32; i++)
+    {
+        uint32_t bit = (1u << i);
+        if(!(changes & bit))
+        {
+            if(mask & bit)
+                count(AttributeState, false);
+            continue;
+        }
+        if(mask & bit)
+            glEnableVertexAttribArray(i);
+        else
+            glDisableVertexAttribArray(i);
+        count(AttributeState, true);
+    }
+    m_attributes = mask;
+    m_attributesKnown = true;
+}
+
+bool StateCacheGL2::setMaterial(uint32_t id)
+{
+    bool changed = (m_material != id);
+    m_material = id;
+    count(MaterialState, changed);
+    return changed;
+}
+
+const StateCacheGL2::Stats & StateCacheGL2::stats() const
+{
+    return m_stats;
+}
+
+void StateCacheGL2::clearStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+string StateCacheGL2::statsText() const
+{
+    static const char *names[CategoryCount] =
+    {
+        "program", "buffer", "texture", "attribute", "material"
+    };
+    uint32_t issued = 0, skipped = 0;
+    stringstream ss;
+    for(int i = 0; i < CategoryCount; i++)
+    {
+        issued += m_stats.issued[i];
+        skipped += m_stats.skipped[i];
+    }
+    ss << "State changes: " << issued << " sent, " << skipped << " skipped";
+    for(int i = 0; i < CategoryCount; i++)
+        ss << "\n  " << names[i] << ": " << m_stats.issued[i] << " / " << m_stats.skipped[i];
+    return ss.str();
+}
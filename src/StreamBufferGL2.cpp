@@ -0,0 +1,153 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Platform.h"
+#include "StreamBufferGL2.h"
+#include "StateCacheGL2.h"
+#include "GLTrace.h"
+
+StreamBufferGL2::StreamBufferGL2(StateCacheGL2 *cache)
+{
+    m_cache = cache;
+    m_buffer = 0;
+    m_persistent = false;
+    m_mapped = 0;
+    m_regionSize = 0;
+    m_size = 0;
+    m_region = 0;
+    for(int i = 0; i < RegionCount; i++)
+        m_fences[i] = 0;
+}
+
+StreamBufferGL2::~StreamBufferGL2()
+{
+    release();
+}
+
+uint32_t StreamBufferGL2::buffer() const
+{
+    return m_buffer;
+}
+
+bool StreamBufferGL2::persistent() const
+{
+    return m_persistent;
+}
+
+void * StreamBufferGL2::map(size_t size)
+{
+    if((size > m_regionSize) || (m_buffer == 0))
+    {
+        size_t regionSize = (m_regionSize > 0) ? m_regionSize : (size_t)MinRegionSize;
+        while(regionSize < size)
+            regionSize *= 2;
+        if(!allocate(regionSize))
+            return 0;
+    }
+    m_region = (m_region + 1) % RegionCount;
+    m_size = size;
+    if(m_persistent)
+    {
+        waitRegion(m_region);
+        return m_mapped + m_region * m_regionSize;
+    }
+    m_staging.resize(size);
+    return &m_staging[0];
+}
+
+size_t StreamBufferGL2::commit()
+{
+    size_t offset = m_region * m_regionSize;
+    if(!m_persistent && (m_size > 0))
+    {
+        m_cache->bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, m_size, &m_staging[0]);
+    }
+    return offset;
+}
+
+void StreamBufferGL2::fence()
+{
+    if(!m_persistent)
+        return;
+    if(m_fences[m_region])
+        glDeleteSync((GLsync)m_fences[m_region]);
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBufferGL2::waitRegion(uint32_t region)
+{
+    GLsync sync = (GLsync)m_fences[region];
+    if(!sync)
+        return;
+    // only blocks when the CPU is more than RegionCount frames ahead
+    GLenum result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while(result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(sync, 0, 1000000000);
+    glDeleteSync(sync);
+    m_fences[region] = 0;
+}
+
+bool StreamBufferGL2::allocate(size_t regionSize)
+{
+    release();
+    size_t size = regionSize * RegionCount;
+    glGenBuffers(1, &m_buffer);
+    if(m_buffer == 0)
+        return false;
+    m_cache->bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    if(GLEW_ARB_buffer_storage && GLEW_ARB_sync)
+    {
+        GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, 0, access | GL_DYNAMIC_STORAGE_BIT);
+        m_mapped = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, access);
+        m_persistent = (m_mapped != 0);
+    }
+    else
+    {
+        glBufferData(GL_ARRAY_BUFFER, size, 0, GL_STREAM_DRAW);
+    }
+    m_regionSize = regionSize;
+    m_region = RegionCount - 1;
+    return true;
+}
+
+void StreamBufferGL2::release()
+{
+    for(int i = 0; i < RegionCount; i++)
+    {
+        if(m_fences[i])
+            glDeleteSync((GLsync)m_fences[i]);
+        m_fences[i] = 0;
+    }
+    if(m_buffer != 0)
+    {
+        // the buffer is unmapped when deleted
+        m_cache->deleteBuffer(m_buffer);
+        m_buffer = 0;
+    }
+    m_mapped = 0;
+    m_persistent = false;
+    m_regionSize = 0;
+    m_size = 0;
+}
@@ -0,0 +1,275 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Thread.h"
+#ifndef WIN32
+#include <unistd.h>
+#include <time.h>
+#endif
+
+#ifdef WIN32
+
+Mutex::Mutex()
+{
+    InitializeCriticalSection(&m_mutex);
+}
+
+Mutex::~Mutex()
+{
+    DeleteCriticalSection(&m_mutex);
+}
+
+void Mutex::lock()
+{
+    EnterCriticalSection(&m_mutex);
+}
+
+void Mutex::unlock()
+{
+    LeaveCriticalSection(&m_mutex);
+}
+
+Condition::Condition()
+{
+    InitializeConditionVariable(&m_cond);
+}
+
+Condition::~Condition()
+{
+}
+
+void Condition::wait(Mutex &m)
+{
+    SleepConditionVariableCS(&m_cond, &m.m_mutex, INFINITE);
+}
+
+void Condition::signal()
+{
+    WakeConditionVariable(&m_cond);
+}
+
+void Condition::broadcast()
+{
+    WakeAllConditionVariable(&m_cond);
+}
+
+Thread::Thread()
+{
+    m_thread = 0;
+    m_function = 0;
+    m_arg = 0;
+}
+
+bool Thread::start(Function f, void *arg)
+{
+    m_function = f;
+    m_arg = arg;
+    m_thread = CreateThread(0, 0, threadMain, this, 0, 0);
+    return m_thread != 0;
+}
+
+void Thread::join()
+{
+    if(m_thread == 0)
+        return;
+    WaitForSingleObject(m_thread, INFINITE);
+    CloseHandle(m_thread);
+    m_thread = 0;
+}
+
+DWORD WINAPI Thread::threadMain(LPVOID param)
+{
+    Thread *t = (Thread *)param;
+    t->m_function(t->m_arg);
+    return 0;
+}
+
+ThreadLocal::ThreadLocal()
+{
+    m_key = TlsAlloc();
+}
+
+ThreadLocal::~ThreadLocal()
+{
+    TlsFree(m_key);
+}
+
+void * ThreadLocal::get() const
+{
+    return TlsGetValue(m_key);
+}
+
+void ThreadLocal::set(void *value)
+{
+    TlsSetValue(m_key, value);
+}
+
+int processorCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+
+void sleepFor(double seconds)
+{
+    if(seconds > 0.0)
+        Sleep((DWORD)(seconds * 1000.0));
+}
+
+int atomicExchange(volatile int *target, int value)
+{
+    return (int)InterlockedExchange((volatile LONG *)target, value);
+}
+
+int atomicAdd(volatile int *target, int value)
+{
+    return (int)InterlockedExchangeAdd((volatile LONG *)target, value) + value;
+}
+
+#else
+
+Mutex::Mutex()
+{
+    pthread_mutex_init(&m_mutex, 0);
+}
+
+Mutex::~Mutex()
+{
+    pthread_mutex_destroy(&m_mutex);
+}
+
+void Mutex::lock()
+{
+    pthread_mutex_lock(&m_mutex);
+}
+
+void Mutex::unlock()
+{
+    pthread_mutex_unlock(&m_mutex);
+}
+
+Condition::Condition()
+{
+    pthread_cond_init(&m_cond, 0);
+}
+
+Condition::~Condition()
+{
+    pthread_cond_destroy(&m_cond);
+}
+
+void Condition::wait(Mutex &m)
+{
+    pthread_cond_wait(&m_cond, &m.m_mutex);
+}
+
+void Condition::signal()
+{
+    pthread_cond_signal(&m_cond);
+}
+
+void Condition::broadcast()
+{
+    pthread_cond_broadcast(&m_cond);
+}
+
+Thread::Thread()
+{
+    m_started = false;
+    m_function = 0;
+    m_arg = 0;
+}
+
+bool Thread::start(Function f, void *arg)
+{
+    m_function = f;
+    m_arg = arg;
+    m_started = (pthread_create(&m_thread, 0, threadMain, this) == 0);
+    return m_started;
+}
+
+void Thread::join()
+{
+    if(!m_started)
+        return;
+    pthread_join(m_thread, 0);
+    m_started = false;
+}
+
+void * Thread::threadMain(void *param)
+{
+    Thread *t = (Thread *)param;
+    t->m_function(t->m_arg);
+    return 0;
+}
+
+ThreadLocal::ThreadLocal()
+{
+    pthread_key_create(&m_key, 0);
+}
+
+ThreadLocal::~ThreadLocal()
+{
+    pthread_key_delete(m_key);
+}
+
+void * ThreadLocal::get() const
+{
+    return pthread_getspecific(m_key);
+}
+
+void ThreadLocal::set(void *value)
+{
+    pthread_setspecific(m_key, value);
+}
+
+int processorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+}
+
+void sleepFor(double seconds)
+{
+    if(seconds <= 0.0)
+        return;
+    timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+    nanosleep(&ts, 0);
+}
+
+int atomicExchange(volatile int *target, int value)
+{
+    // the builtin only keeps later accesses after it
+    __sync_synchronize();
+    return __sync_lock_test_and_set(target, value);
+}
+
+int atomicAdd(volatile int *target, int value)
+{
+    return __sync_add_and_fetch(target, value);
+}
+
+#endif
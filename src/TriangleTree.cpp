@@ -0,0 +1,231 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <algorithm>
+#include "TriangleTree.h"
+
+using namespace std;
+
+static const int LeafSize = 4;
+static const int MaxDepth = 64;
+
+// sorts triangles by the center of their box along one axis
+class TriangleLess
+{
+public:
+    TriangleLess(const vector<vec3> &centers, int axis) : m_centers(centers), m_axis(axis)
+    {
+    }
+
+    bool operator()(int a, int b) const
+    {
+        const vec3 &ca = m_centers[a];
+        const vec3 &cb = m_centers[b];
+        if(m_axis == 0)
+            return ca.x < cb.x;
+        else if(m_axis == 1)
+            return ca.y < cb.y;
+        else
+            return ca.z < cb.z;
+    }
+
+private:
+    const vector<vec3> &m_centers;
+    int m_axis;
+};
+
+static vec3 minimum(const vec3 &a, const vec3 &b)
+{
+    return vec3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z));
+}
+
+static vec3 maximum(const vec3 &a, const vec3 &b)
+{
+    return vec3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z));
+}
+
+TriangleTree::TriangleTree()
+{
+}
+
+const vector<vec3> & TriangleTree::positions() const
+{
+    return m_positions;
+}
+
+void TriangleTree::build(const vector<vec3> &positions)
+{
+    m_nodes.clear();
+    m_positions.clear();
+    int count = positions.size() / 3;
+    if(count == 0)
+        return;
+    vector<vec3> centers(count);
+    vector<int> order(count);
+    for(int i = 0; i < count; i++)
+    {
+        const vec3 *p = &positions[i * 3];
+        vec3 low = minimum(minimum(p[0], p[1]), p[2]);
+        vec3 high = maximum(maximum(p[0], p[1]), p[2]);
+        centers[i] = vec3((low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f, (low.z + high.z) * 0.5f);
+        order[i] = i;
+    }
+    m_positions.reserve(count * 3);
+    buildNode(order, 0, count, centers);
+
+    // the triangles were only sorted by index so far
+    for(int i = 0; i < count; i++)
+    {
+        for(int j = 0; j < 3; j++)
+            m_positions.push_back(positions[order[i] * 3 + j]);
+    }
+    for(size_t i = 0; i < m_nodes.size(); i++)
+    {
+        Node &n = m_nodes[i];
+        if(n.count == 0)
+            continue;
+        n.low = n.high = m_positions[n.first * 3];
+        for(int j = n.first * 3; j < (n.first + n.count) * 3; j++)
+        {
+            n.low = minimum(n.low, m_positions[j]);
+            n.high = maximum(n.high, m_positions[j]);
+        }
+    }
+    for(int i = (int)m_nodes.size() - 1; i >= 0; i--)
+    {
+        Node &n = m_nodes[i];
+        if(n.count > 0)
+            continue;
+        n.low = minimum(m_nodes[i + 1].low, m_nodes[n.first].low);
+        n.high = maximum(m_nodes[i + 1].high, m_nodes[n.first].high);
+    }
+}
+
+int TriangleTree::buildNode(vector<int> &order, int first, int last, const vector<vec3> &centers)
+{
+    int index = m_nodes.size();
+    Node n;
+    n.first = first;
+    n.count = last - first;
+    m_nodes.push_back(n);
+    if((last - first) <= LeafSize)
+        return index;
+
+    // split at the median, along the axis where the triangles are the most spread
+    vec3 low = centers[order[first]], high = low;
+    for(int i = first + 1; i < last; i++)
+    {
+        low = minimum(low, centers[order[i]]);
+        high = maximum(high, centers[order[i]]);
+    }
+    vec3 size = high - low;
+    int axis = (size.x > size.y) ? ((size.x > size.z) ? 0 : 2) : ((size.y > size.z) ? 1 : 2);
+    int middle = (first + last) / 2;
+    nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                TriangleLess(centers, axis));
+    buildNode(order, first, middle, centers);
+    int right = buildNode(order, middle, last, centers);
+    m_nodes[index].first = right;
+    m_nodes[index].count = 0;
+    return index;
+}
+
+bool TriangleTree::intersect(const vec3 &origin, const vec3 &direction, float &distance) const
+{
+    if(m_nodes.empty())
+        return false;
+    // divisions by zero give infinities, which the slab test handles
+    vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    bool hit = false;
+    int stack[MaxDepth];
+    int top = 0;
+    stack[top++] = 0;
+    while(top > 0)
+    {
+        int i = stack[--top];
+        const Node &n = m_nodes[i];
+        if(!intersectBox(n, origin, inverse, distance))
+            continue;
+        if(n.count > 0)
+        {
+            for(int j = n.first; j < (n.first + n.count); j++)
+            {
+                if(intersectTriangle(j, origin, direction, distance))
+                    hit = true;
+            }
+        }
+        else
+        {
+            stack[top++] = n.first;
+            stack[top++] = i + 1;
+        }
+    }
+    return hit;
+}
+
+bool TriangleTree::intersectBox(const Node &n, const vec3 &origin, const vec3 &inverse,
+                                float distance) const
+{
+    float t1 = (n.low.x - origin.x) * inverse.x, t2 = (n.high.x - origin.x) * inverse.x;
+    float entry = min(t1, t2), exit = max(t1, t2);
+    t1 = (n.low.y - origin.y) * inverse.y;
+    t2 = (n.high.y - origin.y) * inverse.y;
+    entry = max(entry, min(t1, t2));
+    exit = min(exit, max(t1, t2));
+    t1 = (n.low.z - origin.z) * inverse.z;
+    t2 = (n.high.z - origin.z) * inverse.z;
+    entry = max(entry, min(t1, t2));
+    exit = min(exit, max(t1, t2));
+    return (entry <= exit) && (exit >= 0.0) && (entry < distance);
+}
+
+bool TriangleTree::intersectTriangle(int index, const vec3 &origin, const vec3 &direction,
+                                     float &distance) const
+{
+    // Moller-Trumbore, triangles are hit from both sides
+    const vec3 *p = &m_positions[index * 3];
+    vec3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+    vec3 pv(direction.y * e2.z - direction.z * e2.y,
+            direction.z * e2.x - direction.x * e2.z,
+            direction.x * e2.y - direction.y * e2.x);
+    float det = e1.x * pv.x + e1.y * pv.y + e1.z * pv.z;
+    if(fabs(det) < 1e-12f)
+        return false;
+    float inv = 1.0f / det;
+    vec3 tv = origin - p[0];
+    float u = (tv.x * pv.x + tv.y * pv.y + tv.z * pv.z) * inv;
+    if((u < 0.0) || (u > 1.0))
+        return false;
+    vec3 qv(tv.y * e1.z - tv.z * e1.y,
+            tv.z * e1.x - tv.x * e1.z,
+            tv.x * e1.y - tv.y * e1.x);
+    float v = (direction.x * qv.x + direction.y * qv.y + direction.z * qv.z) * inv;
+    if((v < 0.0) || ((u + v) > 1.0))
+        return false;
+    float t = (e2.x * qv.x + e2.y * qv.y + e2.z * qv.z) * inv;
+    if((t <= 0.0) || (t >= distance))
+        return false;
+    distance = t;
+    return true;
+}
@@ -68,6 +68,24 @@ vec3 operator-(const vec3 &a, const vec3 &b)
     return u;
 }
 
+void mergeSpheres(vec3 &center, float &radius, const vec3 &center2, float radius2)
+{
+    vec3 d = center2 - center;
+    float dist = sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+    if(dist + radius2 <= radius)
+        return;
+    if(dist + radius <= radius2)
+    {
+        center = center2;
+        radius = radius2;
+        return;
+    }
+    float merged = (dist + radius + radius2) * 0.5f;
+    float t = (merged - radius) / dist;
+    center = vec3(center.x + d.x * t, center.y + d.y * t, center.z + d.z * t);
+    radius = merged;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 matrix4::matrix4()
@@ -107,6 +125,55 @@ void matrix4::setIdentity()
     d[0] = d[5] = d[10] = d[15] = 1.0;
 }
 
+matrix4 matrix4::inverse() const
+{
+    // cofactors of each element, divided by the determinant
+    matrix4 m;
+    float *r = m.d;
+    r[0] = d[5] * d[10] * d[15] - d[5] * d[11] * d[14] - d[9] * d[6] * d[15]
+         + d[9] * d[7] * d[14] + d[13] * d[6] * d[11] - d[13] * d[7] * d[10];
+    r[4] = -d[4] * d[10] * d[15] + d[4] * d[11] * d[14] + d[8] * d[6] * d[15]
+         - d[8] * d[7] * d[14] - d[12] * d[6] * d[11] + d[12] * d[7] * d[10];
+    r[8] = d[4] * d[9] * d[15] - d[4] * d[11] * d[13] - d[8] * d[5] * d[15]
+         + d[8] * d[7] * d[13] + d[12] * d[5] * d[11] - d[12] * d[7] * d[9];
+    r[12] = -d[4] * d[9] * d[14] + d[4] * d[10] * d[13] + d[8] * d[5] * d[14]
+          - d[8] * d[6] * d[13] - d[12] * d[5] * d[10] + d[12] * d[6] * d[9];
+    r[1] = -d[1] * d[10] * d[15] + d[1] * d[11] * d[14] + d[9] * d[2] * d[15]
+         - d[9] * d[3] * d[14] - d[13] * d[2] * d[11] + d[13] * d[3] * d[10];
+    r[5] = d[0] * d[10] * d[15] - d[0] * d[11] * d[14] - d[8] * d[2] * d[15]
+         + d[8] * d[3] * d[14] + d[12] * d[2] * d[11] - d[12] * d[3] * d[10];
+    r[9] = -d[0] * d[9] * d[15] + d[0] * d[11] * d[13] + d[8] * d[1] * d[15]
+         - d[8] * d[3] * d[13] - d[12] * d[1] * d[11] + d[12] * d[3] * d[9];
+    r[13] = d[0] * d[9] * d[14] - d[0] * d[10] * d[13] - d[8] * d[1] * d[14]
+          + d[8] * d[2] * d[13] + d[12] * d[1] * d[10] - d[12] * d[2] * d[9];
+    r[2] = d[1] * d[6] * d[15] - d[1] * d[7] * d[14] - d[5] * d[2] * d[15]
+         + d[5] * d[3] * d[14] + d[13] * d[2] * d[7] - d[13] * d[3] * d[6];
+    r[6] = -d[0] * d[6] * d[15] + d[0] * d[7] * d[14] + d[4] * d[2] * d[15]
+         - d[4] * d[3] * d[14] - d[12] * d[2] * d[7] + d[12] * d[3] * d[6];
+    r[10] = d[0] * d[5] * d[15] - d[0] * d[7] * d[13] - d[4] * d[1] * d[15]
+          + d[4] * d[3] * d[13] + d[12] * d[1] * d[7] - d[12] * d[3] * d[5];
+    r[14] = -d[0] * d[5] * d[14] + d[0] * d[6] * d[13] + d[4] * d[1] * d[14]
+          - d[4] * d[2] * d[13] - d[12] * d[1] * d[6] + d[12] * d[2] * d[5];
+    r[3] = -d[1] * d[6] * d[11] + d[1] * d[7] * d[10] + d[5] * d[2] * d[11]
+         - d[5] * d[3] * d[10] - d[9] * d[2] * d[7] + d[9] * d[3] * d[6];
+    r[7] = d[0] * d[6] * d[11] - d[0] * d[7] * d[10] - d[4] * d[2] * d[11]
+         + d[4] * d[3] * d[10] + d[8] * d[2] * d[7] - d[8] * d[3] * d[6];
+    r[11] = -d[0] * d[5] * d[11] + d[0] * d[7] * d[9] + d[4] * d[1] * d[11]
+          - d[4] * d[3] * d[9] - d[8] * d[1] * d[7] + d[8] * d[3] * d[5];
+    r[15] = d[0] * d[5] * d[10] - d[0] * d[6] * d[9] - d[4] * d[1] * d[10]
+          + d[4] * d[2] * d[9] + d[8] * d[1] * d[6] - d[8] * d[2] * d[5];
+
+    float det = d[0] * r[0] + d[1] * r[4] + d[2] * r[8] + d[3] * r[12];
+    if(det == 0.0)
+    {
+        m.clear();
+        return m;
+    }
+    for(int i = 0; i < 16; i++)
+        r[i] /= det;
+    return m;
+}
+
 matrix4 matrix4::translate(float dx, float dy, float dz)
 {
     matrix4 m;
@@ -21,9 +21,13 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <cstdlib>
+#include <cstring>
 #include <QApplication>
 #include <QGLFormat>
 #include <QMessageBox>
+#include <QDesktopServices>
+#include <QDir>
 #include "SceneViewport.h"
 #include "Scene.h"
 #include "RenderState.h"
@@ -33,6 +37,18 @@
 int main(int argc, char **argv)
 {
     QApplication app(argc, argv);
+
+    // '--crowd N' draws N dragons, to measure how the renderer scales
+    // '--latency N' lets the GPU be up to N frames behind, from 1 to 3
+    int crowdSize = 0;
+    int frameLatency = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        if((strcmp(argv[i], "--crowd") == 0) && ((i + 1) < argc))
+            crowdSize = atoi(argv[++i]);
+        else if((strcmp(argv[i], "--latency") == 0) && ((i + 1) < argc))
+            frameLatency = atoi(argv[++i]);
+    }
     
     // define OpenGL options
     QGLFormat f;
@@ -42,7 +58,14 @@ int main(int argc, char **argv)
 
     // create the scene
     RenderStateGL2 state;
-    Scene scene(&state);
+    if(frameLatency > 0)
+        state.setFrameLatency(frameLatency);
+    Scene scene(&state, crowdSize);
+
+    // keep the compiled shaders between launches
+    QString cacheDir = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+    if(!cacheDir.isEmpty() && QDir().mkpath(cacheDir))
+        state.setProgramCacheDir(cacheDir.toStdString());
 
     // create viewport for rendering the scene
     SceneViewport w(&scene, &state, f);
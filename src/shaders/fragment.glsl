@@ -1,12 +1,58 @@
-uniform int u_has_texture;
-uniform sampler2D u_material_texture;
+#ifdef PER_PIXEL_LIGHTING
+#ifdef UNIFORM_BLOCKS
+layout(std140) uniform FrameBlock
+{
+    mat4 u_projectionMatrix;
+    vec4 u_light_ambient;
+    vec4 u_light_diffuse;
+    vec4 u_light_specular;
+    vec4 u_light_pos;
+};
+
+layout(std140) uniform MaterialBlock
+{
+    vec4 u_material_ambient;
+    vec4 u_material_diffuse;
+    vec4 u_material_specular;
+    float u_material_shine;
+};
+#else
+uniform vec4 u_light_ambient;
+uniform vec4 u_light_diffuse;
+uniform vec4 u_light_specular;
 
+uniform vec4 u_material_ambient;
+uniform vec4 u_material_diffuse;
+uniform vec4 u_material_specular;
+uniform float u_material_shine;
+#endif
+
+varying vec3 v_normal, v_lightDir, v_halfVector;
+#else
 varying vec4 v_color;
+#endif
+
+#ifdef TEXTURED
+uniform sampler2D u_material_texture;
 varying vec2 v_texCoords;
+#endif
 
 void main()
 {
+#ifdef PER_PIXEL_LIGHTING
+    // the interpolated vectors are not unit length anymore
+    vec3 normal = normalize(v_normal);
+    vec3 halfVector = normalize(v_halfVector);
+    vec4 diffuse, ambient, specular;
+    ambient = u_material_ambient * u_light_ambient;
+    diffuse = max(dot(normal, v_lightDir), 0.0) * u_material_diffuse * u_light_diffuse;
+    specular = pow(max(dot(normal, halfVector), 0.0), u_material_shine)
+        * u_material_specular * u_light_specular;
+    gl_FragColor = ambient + diffuse + specular;
+#else
     gl_FragColor = v_color;
-    if(u_has_texture != 0)
-        gl_FragColor = gl_FragColor * texture2D(u_material_texture, v_texCoords);
+#endif
+#ifdef TEXTURED
+    gl_FragColor = gl_FragColor * texture2D(u_material_texture, v_texCoords);
+#endif
 }
@@ -0,0 +1,10 @@
+attribute vec2 a_position;
+
+varying vec2 v_texCoords;
+
+void main()
+{
+    // the quad covers the viewport, the texture covers the quad
+    v_texCoords = a_position * 0.5 + 0.5;
+    gl_Position = vec4(a_position, 0.0, 1.0);
+}
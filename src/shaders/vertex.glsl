@@ -1,30 +1,66 @@
 attribute vec3 a_position;
 attribute vec3 a_normal;
+#ifdef TEXTURED
 attribute vec2 a_texCoords;
+#endif
 
+#ifdef INSTANCED
+attribute mat4 a_modelViewMatrix;
+#define u_modelViewMatrix a_modelViewMatrix
+#else
 uniform mat4 u_modelViewMatrix;
+#endif
+
+#ifdef UNIFORM_BLOCKS
+layout(std140) uniform FrameBlock
+{
+    mat4 u_projectionMatrix;
+    vec4 u_light_ambient;
+    vec4 u_light_diffuse;
+    vec4 u_light_specular;
+    vec4 u_light_pos;
+};
+
+layout(std140) uniform MaterialBlock
+{
+    vec4 u_material_ambient;
+    vec4 u_material_diffuse;
+    vec4 u_material_specular;
+    float u_material_shine;
+};
+#else
 uniform mat4 u_projectionMatrix;
 
+uniform vec4 u_light_pos;
+#ifndef PER_PIXEL_LIGHTING
 uniform vec4 u_light_ambient;
 uniform vec4 u_light_diffuse;
 uniform vec4 u_light_specular;
-uniform vec4 u_light_pos;
 
 uniform vec4 u_material_ambient;
 uniform vec4 u_material_diffuse;
 uniform vec4 u_material_specular;
 uniform float u_material_shine;
+#endif
+#endif
 
+#ifdef PER_PIXEL_LIGHTING
+varying vec3 v_normal, v_lightDir, v_halfVector;
+#else
 varying vec4 v_color;
+#endif
+#ifdef TEXTURED
 varying vec2 v_texCoords;
+#endif
 
 void main()
 {
     gl_Position = u_projectionMatrix * u_modelViewMatrix * vec4(a_position, 1.0);
+#ifdef TEXTURED
     v_texCoords = a_texCoords;
+#endif
 
     vec3 normal, lightDir, halfVector;
-    vec4 diffuse, ambient, specular;
     mat3 normalMatrix;
     normalMatrix[0] = vec3(u_modelViewMatrix[0]);
     normalMatrix[1] = vec3(u_modelViewMatrix[1]);
@@ -34,10 +70,17 @@ void main()
     lightDir = normalize(u_light_pos.xyz);
     halfVector = normalize(lightDir + vec3(0, 0, 1));
 
+#ifdef PER_PIXEL_LIGHTING
+    v_normal = normal;
+    v_lightDir = lightDir;
+    v_halfVector = halfVector;
+#else
+    vec4 diffuse, ambient, specular;
     ambient = u_material_ambient * u_light_ambient;
     diffuse = max(dot(normal, lightDir), 0.0) * u_material_diffuse * u_light_diffuse;
     specular = pow(max(dot(normal, halfVector), 0.0), u_material_shine)
         * u_material_specular * u_light_specular;
 
     v_color = ambient + diffuse + specular;
+#endif
 }
@@ -0,0 +1,59 @@
+// Copyright (c) 2009-2015, Pierre-Andre Saulais <pasaulais@free.fr>
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this
+//    list of conditions and the following disclaimer. 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+// ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include "AnimationCurve.h"
+#include "DragonPoses.h"
+#include "Scene.h"
+
+// Bake the curves the way the program does, then check that the tables stay
+// within their tolerance of the functions between samples too.
+static int checkCurves(const AnimationCurve::Source *sources, int count)
+{
+    int failed = 0;
+    for(int i = 0; i < count; i++)
+    {
+        const AnimationCurve::Source &s = sources[i];
+        AnimationCurve curve;
+        curve.bake(s);
+        // a prime number of points, so that they rarely fall on samples
+        float error = curve.measure(s.function, 10007);
+        bool passed = (error <= s.tolerance);
+        printf("%s curve '%s': %d samples, error %g (tolerance %g)\n",
+            passed ? "PASS" : "FAIL", s.name, curve.size(), error, s.tolerance);
+        if(!passed)
+            failed++;
+    }
+    return failed;
+}
+
+int main()
+{
+    int count = 0;
+    int failed = 0;
+    const AnimationCurve::Source *sources = DragonPoses::curveSources(count);
+    failed += checkCurves(sources, count);
+    sources = Scene::curveSources(count);
+    failed += checkCurves(sources, count);
+    return (failed > 0) ? 1 : 0;
+}